@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_COMMON_SIMD_HPP
+#define IPTSD_COMMON_SIMD_HPP
+
+#include "types.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace iptsd::common::simd {
+
+/*
+ * Instruction sets with dedicated code paths. On x86 the SSE2 path is the baseline, on arm64
+ * NEON is always available.
+ */
+enum class Isa {
+	scalar,
+	sse2,
+	avx2,
+	neon,
+};
+
+inline auto detect() -> Isa
+{
+#if defined(IPTSD_CONFIG_DISABLE_SIMD)
+	return Isa::scalar;
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return Isa::avx2;
+
+	return Isa::sse2;
+#elif defined(__aarch64__)
+	return Isa::neon;
+#else
+	return Isa::scalar;
+#endif
+}
+
+namespace impl {
+
+inline auto active() -> Isa &
+{
+	static Isa isa = detect();
+	return isa;
+}
+
+} /* namespace impl */
+
+/*
+ * The instruction set used by the optimized code paths. Detected once on first use.
+ */
+inline auto isa() -> Isa
+{
+	return impl::active();
+}
+
+/*
+ * Overrides the detected instruction set, e.g. to compare the code paths in benchmarks.
+ * Selecting an instruction set that is not supported by the CPU is undefined behavior.
+ */
+inline void force(Isa isa)
+{
+	impl::active() = isa;
+}
+
+inline auto name(Isa isa) -> const char *
+{
+	switch (isa) {
+	case Isa::sse2:
+		return "sse2";
+	case Isa::avx2:
+		return "avx2";
+	case Isa::neon:
+		return "neon";
+	default:
+		return "scalar";
+	}
+}
+
+/*
+ * Vector types of the optimized code paths, as compiler vector extensions. The arithmetic
+ * operators work element-wise, comparisons return a mask of the integer type of same width.
+ * The 8-wide types may only be used in functions compiled for AVX2.
+ */
+using f32x4 = Float32 __attribute__((vector_size(16)));
+using i32x4 = SInt32 __attribute__((vector_size(16)));
+
+#if defined(__x86_64__) || defined(__i386__)
+using f32x8 = Float32 __attribute__((vector_size(32)));
+using i32x8 = SInt32 __attribute__((vector_size(32)));
+#endif
+
+/*
+ * Element-wise m ? a : b, where m is the result of a comparison.
+ */
+[[gnu::always_inline]] inline auto select(i32x4 m, f32x4 a, f32x4 b) -> f32x4
+{
+	return (f32x4)((m & (i32x4)a) | (~m & (i32x4)b));
+}
+
+[[gnu::always_inline]] inline auto sqrt(f32x4 v) -> f32x4
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (f32x4)_mm_sqrt_ps((__m128)v);
+#elif defined(__aarch64__)
+	return (f32x4)vsqrtq_f32((float32x4_t)v);
+#else
+	return f32x4 {std::sqrt(v[0]), std::sqrt(v[1]), std::sqrt(v[2]), std::sqrt(v[3])};
+#endif
+}
+
+/*
+ * The 8-wide versions are not always_inline, so that they only get inlined where AVX2 is
+ * enabled.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+inline __attribute__((target("avx2"))) auto select(i32x8 m, f32x8 a, f32x8 b) -> f32x8
+{
+	return (f32x8)((m & (i32x8)a) | (~m & (i32x8)b));
+}
+
+inline __attribute__((target("avx2"))) auto sqrt(f32x8 v) -> f32x8
+{
+	return (f32x8)_mm256_sqrt_ps((__m256)v);
+}
+#endif
+
+} /* namespace iptsd::common::simd */
+
+#endif /* IPTSD_COMMON_SIMD_HPP */
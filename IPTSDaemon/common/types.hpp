@@ -3,7 +3,7 @@
 #ifndef IPTSD_COMMON_TYPES_HPP
 #define IPTSD_COMMON_TYPES_HPP
 
-#include <IOKit/IOTypes.h>
+#include "../../IPTSKenerlUserShared.h"
 
 #include <cmath>
 #include <cstdint>
@@ -7,12 +7,19 @@
 #include <container/image.hpp>
 #include <container/kernel.hpp>
 #include <container/ops.hpp>
+#include <container/tensor_image.hpp>
 
 #include <math/num.hpp>
 #include <math/vec2.hpp>
 
+#include "opt/convolution.simd.hpp"
 #include "opt/convolution.3x3-extend.hpp"
+#include "opt/convolution.3x3-zero.hpp"
 #include "opt/convolution.5x5-extend.hpp"
+#include "opt/convolution.separable-extend.hpp"
+
+#include <algorithm>
+#include <array>
 
 using namespace iptsd::container;
 using namespace iptsd::math;
@@ -20,6 +27,16 @@ using namespace iptsd::math;
 
 namespace iptsd::contacts::advanced::alg {
 namespace conv {
+
+/*
+ * Separable kernel k(i, j) = x(i) * y(j), stored as its two 1D factors.
+ */
+template<class T, index_t Nx, index_t Ny>
+struct Separable {
+    Kernel<T, Nx, 1> x;
+    Kernel<T, 1, Ny> y;
+};
+
 namespace kernels {
 
 template<class T>
@@ -89,6 +106,48 @@ auto gaussian(T sigma) -> Kernel<T, Nx, Ny>
     return k;
 }
 
+template<class T, index_t N>
+auto gaussian_1d(T sigma) -> std::array<T, N>
+{
+    static_assert(N % 2 == 1);
+
+    auto k = std::array<T, N>{};
+
+    T sum = static_cast<T>(0.0);
+
+    for (index_t i = 0; i < N; i++) {
+        auto const x = static_cast<T>(i - (N - 1) / 2) / sigma;
+        auto const v = std::exp(-static_cast<T>(0.5) * x * x);
+
+        k[i] = v;
+        sum += v;
+    }
+
+    for (auto& v : k) {
+        v /= sum;
+    }
+
+    return k;
+}
+
+/*
+ * Same as gaussian(), but in separated form. The product of the normalized 1D factors is
+ * the normalized 2D kernel.
+ */
+template<class T, index_t Nx, index_t Ny>
+auto gaussian_separable(T sigma) -> Separable<T, Nx, Ny>
+{
+    auto k = Separable<T, Nx, Ny>{};
+
+    auto const kx = gaussian_1d<T, Nx>(sigma);
+    auto const ky = gaussian_1d<T, Ny>(sigma);
+
+    std::copy(kx.begin(), kx.end(), k.x.begin());
+    std::copy(ky.begin(), ky.end(), k.y.begin());
+
+    return k;
+}
+
 } /* namespace kernels */
 
 
@@ -125,9 +184,38 @@ void convolve(Image<T>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k)
         conv::impl::conv_5x5_extend<T, S>(out, in, k);
     } else if constexpr (Nx == 3 && Ny == 3 && std::is_same_v<B, border::Extend>) {
         conv::impl::conv_3x3_extend<T, S>(out, in, k);
+    } else if constexpr (Nx == 3 && Ny == 3 && std::is_same_v<B, border::Zero>) {
+        conv::impl::conv_3x3_zero<T, S>(out, in, k);
     } else {
         conv::impl::conv_generic<B, T, S, Nx, Ny>(out, in, k);
     }
 }
 
+template<typename B=border::Extend, typename T, typename S, index_t Nx, index_t Ny>
+void convolve(Image<T>& out, Image<T> const& in, conv::Separable<S, Nx, Ny> const& k)
+{
+    static_assert(std::is_same_v<B, border::Extend>, "separable convolution only supports extended borders");
+
+    conv::impl::conv_separable_extend<T, S, Nx, Ny>(out, in, k.x, k.y);
+}
+
+/*
+ * Planar tensor images are convolved component-wise, each plane as a scalar image.
+ */
+template<typename B=border::Extend, typename T, typename S, index_t Nx, index_t Ny>
+void convolve(TensorImage<T>& out, TensorImage<T> const& in, Kernel<S, Nx, Ny> const& k)
+{
+    convolve<B>(out.xx(), in.xx(), k);
+    convolve<B>(out.xy(), in.xy(), k);
+    convolve<B>(out.yy(), in.yy(), k);
+}
+
+template<typename B=border::Extend, typename T, typename S, index_t Nx, index_t Ny>
+void convolve(TensorImage<T>& out, TensorImage<T> const& in, conv::Separable<S, Nx, Ny> const& k)
+{
+    convolve<B>(out.xx(), in.xx(), k);
+    convolve<B>(out.xy(), in.xy(), k);
+    convolve<B>(out.yy(), in.yy(), k);
+}
+
 } /* namespace iptsd::contacts::advanced::alg */
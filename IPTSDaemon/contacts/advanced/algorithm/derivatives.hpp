@@ -0,0 +1,39 @@
+#pragma once
+
+#include <common/types.hpp>
+
+#include "border.hpp"
+#include "convolution.hpp"
+
+#include <container/image.hpp>
+#include <container/kernel.hpp>
+#include <container/tensor_image.hpp>
+
+#include <math/num.hpp>
+#include <math/mat2.hpp>
+
+#include <cassert>
+
+#include "opt/derivatives.3x3-zero.hpp"
+
+using namespace iptsd::container;
+using namespace iptsd::math;
+
+
+namespace iptsd::contacts::advanced::alg {
+
+/*
+ * Computes the structure tensor and the hessian of an image in a single sweep, loading each
+ * 3x3 neighborhood only once for all five derivative kernels. The result is the same as
+ * structure_tensor() followed by hessian(), with the default kernels and zero borders.
+ */
+template<typename T>
+void derivatives(TensorImage<T>& st, TensorImage<T>& hs, Image<T> const& in)
+{
+    assert(in.size() == st.size());
+    assert(in.size() == hs.size());
+
+    deriv::impl::derivatives_3x3_zero<T>(st, hs, in);
+}
+
+} /* namespace iptsd::contacts::advanced::alg */
@@ -3,8 +3,12 @@
 #include <common/types.hpp>
 #include <container/image.hpp>
 
-#include <queue>
+#include <array>
+#include <cmath>
+#include <limits>
 #include <numeric>
+#include <queue>
+#include <vector>
 
 using namespace iptsd::container;
 
@@ -55,6 +59,134 @@ auto operator> (struct QItem<T> const& a, struct QItem<T> const& b) noexcept ->
 }
 
 
+/*
+ * Per-pixel state of the two-class distance transform: the distance to the closest
+ * foreground pixel of each class, and which of these have changed but have not been
+ * passed on to the neighbors yet.
+ */
+template<typename T>
+struct Dual {
+    std::array<T, 2> dist;
+    UInt8 pending;
+};
+
+
+/*
+ * Bucket (Dial) queue as a drop-in replacement for std::priority_queue in the distance
+ * transform. Costs in [0, limit) are sorted into buckets of fixed width, items within one
+ * bucket are returned in arbitrary order. As long as the width is at most the smallest edge
+ * cost, every item pushed while a bucket is processed goes to a later bucket, so the result
+ * of the transform is the same as with an exact priority queue. Otherwise, the transform
+ * still converges, but may visit pixels multiple times.
+ *
+ * The buckets are stacks linked through one shared pool of nodes, so the queue only allocates
+ * when more items are queued at once than ever before, instead of whenever one of the buckets
+ * outgrows its own storage. reserve() sizes the pool up front.
+ */
+template<typename T>
+class BucketQueue {
+public:
+    BucketQueue(T width, T limit);
+
+    void reserve(std::size_t n);
+
+    void push(QItem<T> const& item);
+    void pop();
+
+    auto top() const -> QItem<T> const&;
+    auto empty() const -> bool;
+    auto size() const -> std::size_t;
+
+private:
+    static constexpr auto const nil = std::numeric_limits<std::size_t>::max();
+
+    struct Node {
+        QItem<T> item;
+        std::size_t next;
+    };
+
+    T m_scale;
+    std::vector<std::size_t> m_buckets;     // top node of each bucket
+    std::vector<Node> m_nodes;
+    std::size_t m_free;                     // top node of the unused nodes
+    std::size_t m_current;
+    std::size_t m_size;
+};
+
+template<typename T>
+BucketQueue<T>::BucketQueue(T width, T limit)
+    : m_scale{static_cast<T>(1) / width}
+    , m_buckets(static_cast<std::size_t>(std::ceil(limit / width)) + 1, nil)
+    , m_nodes{}
+    , m_free{nil}
+    , m_current{0}
+    , m_size{0}
+{}
+
+template<typename T>
+inline void BucketQueue<T>::reserve(std::size_t n)
+{
+    m_nodes.reserve(n);
+}
+
+template<typename T>
+inline void BucketQueue<T>::push(QItem<T> const& item)
+{
+    auto const last = m_buckets.size() - 1;
+    auto const b = item.cost < last / m_scale ? static_cast<std::size_t>(item.cost * m_scale) : last;
+
+    auto n = m_free;
+
+    if (n != nil) {
+        m_free = m_nodes[n].next;
+        m_nodes[n] = Node { item, m_buckets[b] };
+    } else {
+        n = m_nodes.size();
+        m_nodes.push_back(Node { item, m_buckets[b] });
+    }
+
+    m_buckets[b] = n;
+
+    if (m_size == 0 || b < m_current)
+        m_current = b;
+
+    ++m_size;
+}
+
+template<typename T>
+inline void BucketQueue<T>::pop()
+{
+    auto const n = m_buckets[m_current];
+
+    m_buckets[m_current] = m_nodes[n].next;
+    m_nodes[n].next = m_free;
+    m_free = n;
+
+    --m_size;
+
+    while (m_size > 0 && m_buckets[m_current] == nil)
+        ++m_current;
+}
+
+template<typename T>
+inline auto BucketQueue<T>::top() const -> QItem<T> const&
+{
+    return m_nodes[m_buckets[m_current]].item;
+}
+
+template<typename T>
+inline auto BucketQueue<T>::empty() const -> bool
+{
+    return m_size == 0;
+}
+
+template<typename T>
+inline auto BucketQueue<T>::size() const -> std::size_t
+{
+    return m_size;
+}
+
+
 namespace impl {
 
 template<typename T>
@@ -494,4 +626,133 @@ void weighted_distance_transform(Image<T>& out, F& bin, M& mask, C& cost, Q& q,
     }
 }
 
+/*
+ * Weighted distance transform for two classes of foreground pixels at once, sharing the mask
+ * and the cost function. Both distances of a pixel are propagated together, so the cost of
+ * an edge is only evaluated once for both classes. A distance may be passed on before it is
+ * final, in which case it is propagated again once it improves. The result is the same as
+ * running the single-class transform for each class.
+ */
+template<int N=8, typename T, typename F0, typename F1, typename M, typename C, typename Q>
+void weighted_distance_transform(Image<wdt::Dual<T>>& out, F0& bin0, F1& bin1, M& mask, C& cost,
+                                 Q& q, T limit=std::numeric_limits<T>::max())
+{
+    using wdt::impl::is_compute;
+    using wdt::impl::is_foreground;
+
+    static_assert(N == 4 || N == 8);
+
+    auto const inf = std::numeric_limits<T>::max();
+
+    // step 1: foreground pixels start at zero and are queued, everything else at infinity
+    for (index_t i = 0; i < out.size().span(); ++i) {
+        auto& px = out[i];
+
+        px.dist = { inf, inf };
+        px.pending = 0;
+
+        if (is_foreground(bin0, i)) {
+            px.dist[0] = static_cast<T>(0);
+            px.pending |= 1;
+        }
+
+        if (is_foreground(bin1, i)) {
+            px.dist[1] = static_cast<T>(0);
+            px.pending |= 2;
+        }
+
+        if (px.pending) {
+            q.push({ i, static_cast<T>(0) });
+        }
+    }
+
+    auto const relax = [&](index_t i, UInt8 channels, index_t stride, index2_t dir) {
+        auto const j = i + stride;
+
+        bool const c0 = (channels & 1) && is_compute(bin0, mask, j);
+        bool const c1 = (channels & 2) && is_compute(bin1, mask, j);
+
+        if (!c0 && !c1)
+            return;
+
+        auto const c = wdt::impl::get_cost<T>(cost, i, dir);
+
+        auto& src = out[i];
+        auto& dst = out[j];
+
+        auto key = inf;
+
+        if (c0) {
+            auto const d = src.dist[0] + c;
+
+            if (d < dst.dist[0] && d < limit) {
+                dst.dist[0] = d;
+                dst.pending |= 1;
+                key = d;
+            }
+        }
+
+        if (c1) {
+            auto const d = src.dist[1] + c;
+
+            if (d < dst.dist[1] && d < limit) {
+                dst.dist[1] = d;
+                dst.pending |= 2;
+                key = std::min(key, d);
+            }
+        }
+
+        if (key < inf) {
+            q.push({ j, key });
+        }
+    };
+
+    // step 2: pass on all changed distances of the next pixel to its neighbors
+    while (!q.empty()) {
+        auto const idx = q.top().idx;
+        q.pop();
+
+        auto const channels = out[idx].pending;
+        if (!channels)
+            continue;
+
+        out[idx].pending = 0;
+
+        auto const [x, y] = Image<wdt::Dual<T>>::unravel(out.size(), idx);
+        auto const stride = out.stride();
+
+        if (x > 0) {
+            relax(idx, channels, -1, { -1, 0 });
+        }
+
+        if (x < out.size().x - 1) {
+            relax(idx, channels, 1, { 1, 0 });
+        }
+
+        if (y > 0) {
+            if (N == 8 && x > 0) {
+                relax(idx, channels, -stride - 1, { -1, -1 });
+            }
+
+            relax(idx, channels, -stride, { 0, -1 });
+
+            if (N == 8 && x < out.size().x - 1) {
+                relax(idx, channels, -stride + 1, { 1, -1 });
+            }
+        }
+
+        if (y < out.size().y - 1) {
+            if (N == 8 && x > 0) {
+                relax(idx, channels, stride - 1, { -1, 1 });
+            }
+
+            relax(idx, channels, stride, { 0, 1 });
+
+            if (N == 8 && x < out.size().x - 1) {
+                relax(idx, channels, stride + 1, { 1, 1 });
+            }
+        }
+    }
+}
+
 } /* namespace iptsd::contacts::advanced::alg */
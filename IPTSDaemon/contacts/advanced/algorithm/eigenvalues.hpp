@@ -0,0 +1,139 @@
+#pragma once
+
+#include <common/types.hpp>
+
+#include <container/image.hpp>
+#include <container/tensor_image.hpp>
+
+#include <math/num.hpp>
+
+#include <array>
+#include <cassert>
+#include <cmath>
+
+#include "opt/eigenvalues.simd.hpp"
+
+using namespace iptsd::container;
+using namespace iptsd::math;
+
+
+namespace iptsd::contacts::advanced::alg {
+namespace eigen::impl {
+
+/*
+ * Closed form of the eigenvalues of the symmetric matrix [a b; b c]: with the trace t and
+ * s = sqrt((a - c)^2 + 4 b^2), they are (t + s) / 2 and (t - s) / 2. Unlike t^2 - 4 det, the
+ * term under the root can not become negative due to rounding.
+ */
+template<typename T>
+struct Terms {
+    T t, s, det;
+};
+
+template<typename T>
+inline auto terms(T a, T b, T c) -> Terms<T>
+{
+    auto const d = a - c;
+
+    return { a + c, std::sqrt(d * d + 4 * b * b), a * c - b * b };
+}
+
+/*
+ * Eigenvalues, the first one being the one with the larger magnitude.
+ */
+template<typename T>
+inline auto values(Terms<T> const& e) -> std::array<T, 2>
+{
+    auto const ev1 = e.t >= 0 ? (e.t + e.s) / 2 : (e.t - e.s) / 2;
+    auto const ev2 = ev1 != 0 ? e.det / ev1 : math::num<T>::zero;
+
+    return { ev1, ev2 };
+}
+
+/*
+ * Sum of the positive eigenvalues.
+ */
+template<typename T>
+inline auto positive_sum(Terms<T> const& e) -> T
+{
+    // both eigenvalues have the same sign unless the determinant is negative
+    return e.det >= 0 ? std::max(e.t, math::num<T>::zero) : (e.t + e.s) / 2;
+}
+
+/*
+ * Coherence |ev1 - ev2| / (ev1 + ev2), or one if the trace is zero.
+ */
+template<typename T>
+inline auto coherence(Terms<T> const& e) -> T
+{
+    return e.t != 0 ? e.s / e.t : math::num<T>::one;
+}
+
+} /* namespace eigen::impl */
+
+
+/*
+ * Eigenvalues of all pixels of a tensor image, ev1 being the one with the larger magnitude.
+ */
+template<typename T>
+void eigenvalues(Image<T>& ev1, Image<T>& ev2, TensorImage<T> const& in)
+{
+    assert(in.size() == ev1.size());
+    assert(in.size() == ev2.size());
+
+    auto const n = in.size().span();
+
+    auto i = eigen::impl::simd::values(ev1.data(), ev2.data(), in, n);
+
+    for (; i < n; ++i) {
+        auto const e = eigen::impl::terms(in.xx()[i], in.xy()[i], in.yy()[i]);
+        auto const [v1, v2] = eigen::impl::values(e);
+
+        ev1[i] = v1;
+        ev2[i] = v2;
+    }
+}
+
+/*
+ * Sum of the positive eigenvalues of all pixels of a tensor image, without computing the
+ * eigenvalues themselves.
+ */
+template<typename T>
+void eigen_features(Image<T>& pos, TensorImage<T> const& in)
+{
+    assert(in.size() == pos.size());
+
+    auto const n = in.size().span();
+
+    auto i = eigen::impl::simd::features<true, false, T>(pos.data(), nullptr, in, n);
+
+    for (; i < n; ++i) {
+        auto const e = eigen::impl::terms(in.xx()[i], in.xy()[i], in.yy()[i]);
+
+        pos[i] = eigen::impl::positive_sum(e);
+    }
+}
+
+/*
+ * Same as above, also computing the coherence |ev1 - ev2| / (ev1 + ev2), or one where the
+ * trace is zero.
+ */
+template<typename T>
+void eigen_features(Image<T>& pos, Image<T>& coh, TensorImage<T> const& in)
+{
+    assert(in.size() == pos.size());
+    assert(in.size() == coh.size());
+
+    auto const n = in.size().span();
+
+    auto i = eigen::impl::simd::features<true, true, T>(pos.data(), coh.data(), in, n);
+
+    for (; i < n; ++i) {
+        auto const e = eigen::impl::terms(in.xx()[i], in.xy()[i], in.yy()[i]);
+
+        pos[i] = eigen::impl::positive_sum(e);
+        coh[i] = eigen::impl::coherence(e);
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg */
@@ -2,7 +2,9 @@
 
 #include <common/types.hpp>
 #include <container/image.hpp>
+#include <container/image_view.hpp>
 
+#include <math/fast.hpp>
 #include <math/num.hpp>
 
 #include <math/vec2.hpp>
@@ -14,7 +16,11 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
 
 using namespace iptsd::container;
 using namespace iptsd::math;
@@ -31,16 +37,123 @@ struct BBox {
     index_t ymin, ymax;
 };
 
+/*
+ * The parameters of up to N Gaussians, stored as a structure of arrays. Nothing is allocated
+ * after construction: the weight windows of all Gaussians lie one after the other in a single
+ * slab, so the fit walks one block of memory instead of an image per Gaussian.
+ *
+ * Only the first size() entries are in use, see reset().
+ */
+template<class T, std::size_t N>
+class Parameters {
+public:
+    static constexpr std::size_t capacity = N;
+
+    std::array<bool, N>     valid;      // flag to invalidate parameters
+    std::array<T, N>        scale;      // alpha
+    std::array<Vec2<T>, N>  mean;       // mu
+    std::array<Mat2s<T>, N> prec;       // precision matrix, aka. inverse covariance matrix, aka. sigma^-1
+    std::array<BBox, N>     bounds;     // local bounds for sampling, at most window() large
+
+public:
+    Parameters(index2_t window);
+
+    auto size() const -> std::size_t;
+    auto window() const -> index2_t;
+
+    /*
+     * Uses the first n entries, at most the capacity, and invalidates them.
+     */
+    void reset(std::size_t n);
+
+    // local weights for sampling
+    auto weights(std::size_t i) -> ImageView<T>;
+    auto weights(std::size_t i) const -> ImageView<T const>;
+
+private:
+    index2_t m_window;
+    std::size_t m_size;
+    std::vector<T> m_weights;
+};
+
+template<class T, std::size_t N>
+Parameters<T, N>::Parameters(index2_t window)
+    : valid{}
+    , scale{}
+    , mean{}
+    , prec{}
+    , bounds{}
+    , m_window{window}
+    , m_size{0}
+    , m_weights(N * static_cast<std::size_t>(window.span()))
+{}
+
+template<class T, std::size_t N>
+inline auto Parameters<T, N>::size() const -> std::size_t
+{
+    return m_size;
+}
+
+template<class T, std::size_t N>
+inline auto Parameters<T, N>::window() const -> index2_t
+{
+    return m_window;
+}
+
+template<class T, std::size_t N>
+inline void Parameters<T, N>::reset(std::size_t n)
+{
+    m_size = std::min(n, N);
+    std::fill_n(valid.begin(), m_size, false);
+}
+
+template<class T, std::size_t N>
+inline auto Parameters<T, N>::weights(std::size_t i) -> ImageView<T>
+{
+    return { m_window, m_window.x, m_weights.data() + i * static_cast<std::size_t>(m_window.span()) };
+}
+
+template<class T, std::size_t N>
+inline auto Parameters<T, N>::weights(std::size_t i) const -> ImageView<T const>
+{
+    return { m_window, m_window.x, m_weights.data() + i * static_cast<std::size_t>(m_window.span()) };
+}
+
+/*
+ * Powers 0 to 4 of the scaled and centered sample coordinates, per column and per row of
+ * the data. Depends only on the size of the data, so it can be computed once up front.
+ */
 template<class T>
-struct Parameters {
-    bool     valid;     // flag to invalidate parameters
-    T        scale;     // alpha
-    Vec2<T>  mean;      // mu
-    Mat2s<T> prec;      // precision matrix, aka. inverse covariance matrix, aka. sigma^-1
-    BBox     bounds;    // local bounds for sampling
-    Image<T> weights;   // local weights for sampling
+struct Grid {
+    std::vector<std::array<T, 5>> x;
+    std::vector<std::array<T, 5>> y;
+
+    Grid(index2_t size);
 };
 
+template<class T>
+Grid<T>::Grid(index2_t size)
+    : x(size.x)
+    , y(size.y)
+{
+    auto const scale = Vec2<T> {
+        static_cast<T>(2) * range<T>.x / static_cast<T>(size.x),
+        static_cast<T>(2) * range<T>.y / static_cast<T>(size.y),
+    };
+
+    auto const powers = [](T v) -> std::array<T, 5> {
+        return { static_cast<T>(1), v, v * v, v * v * v, v * v * v * v };
+    };
+
+    for (index_t i = 0; i < size.x; ++i) {
+        x[i] = powers(static_cast<T>(i) * scale.x - range<T>.x);
+    }
+
+    for (index_t i = 0; i < size.y; ++i) {
+        y[i] = powers(static_cast<T>(i) * scale.y - range<T>.y);
+    }
+}
+
 
 namespace impl {
 
@@ -49,35 +162,110 @@ namespace impl {
  * @x:    Position at which to evaluate the function.
  * @mean: Mean of the Gaussian.
  * @prec: Precision matrix, i.e. the invariance of the covariance matrix.
+ *
+ * M is the math policy, see math/fast.hpp.
  */
-template<class T>
+template<class M, class T>
 auto gaussian_like(Vec2<T> x, Vec2<T> mean, Mat2s<T> prec) -> T
 {
-    return std::exp(-prec.vtmv(x - mean) / static_cast<T>(2));
+    return M::exp(-prec.vtmv(x - mean) / static_cast<T>(2));
 }
 
 
-template<class T, class S>
+/*
+ * Exponents of x and y of the polynomial terms (x^2, xy, y^2, x, y, 1) of the log-Gaussian.
+ */
+inline constexpr std::array<std::array<index_t, 2>, 6> const terms = {{
+    {2, 0}, {1, 1}, {0, 2}, {1, 0}, {0, 1}, {0, 0},
+}};
+
+/*
+ * Assembles the normal equations of the weighted least-squares fit. Every entry of the
+ * system is a moment sum(d^2 x^a y^b) with a + b <= 4, so only the 15 distinct moments are
+ * accumulated. The sums over a row are computed first and multiplied by the powers of y
+ * afterwards, the matrix is then filled from the moments and mirrored.
+ *
+ * The system is solved for the coefficient of xy, which keeps the matrix symmetric. As
+ * extract_params() expects the coefficient of 2xy, i.e. the off-diagonal entry of the quadratic
+ * form, the second component of the solution has to be halved.
+ */
+template<class M, class T, class S>
 inline void assemble_system(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> const& data,
-                            Image<S> const& w)
+                            ImageView<S const> w, Grid<S> const& grid)
 {
     auto const eps = std::numeric_limits<S>::epsilon();
 
-    auto const scale = Vec2<S> {
-        static_cast<S>(2) * range<S>.x / static_cast<S>(data.size().x),
-        static_cast<S>(2) * range<S>.y / static_cast<S>(data.size().y),
-    };
+    // md[a][b] = sum(d^2 x^a y^b), mv[a][b] = sum(log(d) d^2 x^a y^b)
+    std::array<std::array<S, 5>, 5> md {};
+    std::array<std::array<S, 3>, 3> mv {};
+
+    for (index_t iy = b.ymin; iy <= b.ymax; ++iy) {
+        std::array<S, 5> rd {};
+        std::array<S, 3> rv {};
+
+        for (index_t ix = b.xmin; ix <= b.xmax; ++ix) {
+            auto const& px = grid.x[ix];
 
-    std::fill(m.data.begin(), m.data.end(), math::num<T>::zero);
-    std::fill(rhs.data.begin(), rhs.data.end(), math::num<T>::zero);
+            auto const d = w[{ix - b.xmin, iy - b.ymin}] * static_cast<S>(data[{ix, iy}]);
+            auto const dd = d * d;
+            auto const v = M::log(d + eps) * dd;
+
+            for (index_t k = 0; k < 5; ++k) {
+                rd[k] += dd * px[k];
+            }
+
+            for (index_t k = 0; k < 3; ++k) {
+                rv[k] += v * px[k];
+            }
+        }
+
+        auto const& py = grid.y[iy];
+
+        for (index_t a = 0; a < 5; ++a) {
+            for (index_t k = 0; k < 5 - a; ++k) {
+                md[a][k] += rd[a] * py[k];
+            }
+        }
+
+        for (index_t a = 0; a < 3; ++a) {
+            for (index_t k = 0; k < 3 - a; ++k) {
+                mv[a][k] += rv[a] * py[k];
+            }
+        }
+    }
+
+    for (index_t r = 0; r < 6; ++r) {
+        rhs[r] = mv[terms[r][0]][terms[r][1]];
+
+        for (index_t c = r; c < 6; ++c) {
+            m[{r, c}] = md[terms[r][0] + terms[c][0]][terms[r][1] + terms[c][1]];
+            m[{c, r}] = m[{r, c}];
+        }
+    }
+
+}
+
+/*
+ * Reference for assemble_system(), accumulating all 36 entries of the matrix per sample as
+ * written out in the normal equations. Too slow for the processor, debug/perf.cpp checks the
+ * moment-based assembly against it.
+ */
+template<class M, class T, class S>
+inline void assemble_system_direct(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> const& data,
+                                   ImageView<S const> w, Grid<S> const& grid)
+{
+    auto const eps = std::numeric_limits<S>::epsilon();
+
+    m = Mat6<S>{};
+    rhs = Vec6<S>{};
 
     for (index_t iy = b.ymin; iy <= b.ymax; ++iy) {
         for (index_t ix = b.xmin; ix <= b.xmax; ++ix) {
-            auto const x = static_cast<S>(ix) * scale.x - range<S>.x;
-            auto const y = static_cast<S>(iy) * scale.y - range<S>.y;
+            auto const x = grid.x[ix][1];
+            auto const y = grid.y[iy][1];
 
             auto const d = w[{ix - b.xmin, iy - b.ymin}] * static_cast<S>(data[{ix, iy}]);
-            auto const v = std::log(d + eps) * d * d;
+            auto const v = M::log(d + eps) * d * d;
 
             rhs[0] += v * x * x;
             rhs[1] += v * x * y;
@@ -93,17 +281,17 @@ inline void assemble_system(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> co
             m[{0, 4}] += d * d * x * x * y;
             m[{0, 5}] += d * d * x * x;
 
-            m[{1, 0}] += d * d * x * x * x * y;
-            m[{1, 1}] += d * d * x * x * y * y;
+            m[{1, 0}] += d * d * x * y * x * x;
+            m[{1, 1}] += d * d * x * y * x * y;
             m[{1, 2}] += d * d * x * y * y * y;
-            m[{1, 3}] += d * d * x * x * y;
+            m[{1, 3}] += d * d * x * y * x;
             m[{1, 4}] += d * d * x * y * y;
             m[{1, 5}] += d * d * x * y;
 
-            m[{2, 0}] += d * d * x * x * y * y;
-            m[{2, 1}] += d * d * x * y * y * y;
+            m[{2, 0}] += d * d * y * y * x * x;
+            m[{2, 1}] += d * d * y * y * x * y;
             m[{2, 2}] += d * d * y * y * y * y;
-            m[{2, 3}] += d * d * x * y * y;
+            m[{2, 3}] += d * d * y * y * x;
             m[{2, 4}] += d * d * y * y * y;
             m[{2, 5}] += d * d * y * y;
 
@@ -114,10 +302,10 @@ inline void assemble_system(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> co
             m[{3, 4}] += d * d * x * y;
             m[{3, 5}] += d * d * x;
 
-            m[{4, 0}] += d * d * x * x * y;
-            m[{4, 1}] += d * d * x * y * y;
+            m[{4, 0}] += d * d * y * x * x;
+            m[{4, 1}] += d * d * y * x * y;
             m[{4, 2}] += d * d * y * y * y;
-            m[{4, 3}] += d * d * x * y;
+            m[{4, 3}] += d * d * y * x;
             m[{4, 4}] += d * d * y * y;
             m[{4, 5}] += d * d * y;
 
@@ -129,13 +317,6 @@ inline void assemble_system(Mat6<S>& m, Vec6<S>& rhs, BBox const& b, Image<T> co
             m[{5, 5}] += d * d;
         }
     }
-
-    m[{0, 1}] *= static_cast<S>(2);
-    m[{1, 1}] *= static_cast<S>(2);
-    m[{2, 1}] *= static_cast<S>(2);
-    m[{3, 1}] *= static_cast<S>(2);
-    m[{4, 1}] *= static_cast<S>(2);
-    m[{5, 1}] *= static_cast<S>(2);
 }
 
 template<class T>
@@ -159,90 +340,99 @@ bool extract_params(Vec6<T> const& chi, T& scale, Vec2<T>& mean, Mat2s<T>& prec,
 }
 
 
-template<class T>
-inline void update_weight_maps(std::vector<Parameters<T>>& params, Image<T>& total)
+template<class M, class T, std::size_t N>
+inline void update_weight_maps(Parameters<T, N>& params, Image<T>& total, Grid<T> const& grid)
 {
-    auto const scale = Vec2<T> {
-        static_cast<T>(2) * range<T>.x / static_cast<T>(total.size().x),
-        static_cast<T>(2) * range<T>.y / static_cast<T>(total.size().y),
-    };
-
     std::fill(total.begin(), total.end(), math::num<T>::zero);
 
     // compute individual Gaussians in sample windows
-    for (auto& p : params) {
-        if (!p.valid) {
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        if (!params.valid[i]) {
             continue;
         }
 
-        for (index_t iy = p.bounds.ymin; iy <= p.bounds.ymax; ++iy) {
-            for (index_t ix = p.bounds.xmin; ix <= p.bounds.xmax; ++ix) {
-                auto const x = static_cast<T>(ix) * scale.x - range<T>.x;
-                auto const y = static_cast<T>(iy) * scale.y - range<T>.y;
+        auto const& b = params.bounds[i];
+        auto const w = params.weights(i);
 
-                auto const v = p.scale * gaussian_like<T>({x, y}, p.mean, p.prec);
+        for (index_t iy = b.ymin; iy <= b.ymax; ++iy) {
+            for (index_t ix = b.xmin; ix <= b.xmax; ++ix) {
+                auto const x = grid.x[ix][1];
+                auto const y = grid.y[iy][1];
 
-                p.weights[{ix - p.bounds.xmin, iy - p.bounds.ymin}] = v;
+                auto const v = params.scale[i] * gaussian_like<M, T>({x, y}, params.mean[i], params.prec[i]);
+
+                w[{ix - b.xmin, iy - b.ymin}] = v;
             }
         }
     }
 
     // sum up total
-    for (auto& p : params) {
-        if (!p.valid) {
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        if (!params.valid[i]) {
             continue;
         }
 
-        for (index_t y = p.bounds.ymin; y <= p.bounds.ymax; ++y) {
-            for (index_t x = p.bounds.xmin; x <= p.bounds.xmax; ++x) {
-                total[{x, y}] += p.weights[{x - p.bounds.xmin, y - p.bounds.ymin}];
+        auto const& b = params.bounds[i];
+        auto const w = params.weights(i);
+
+        for (index_t y = b.ymin; y <= b.ymax; ++y) {
+            for (index_t x = b.xmin; x <= b.xmax; ++x) {
+                total[{x, y}] += w[{x - b.xmin, y - b.ymin}];
             }
         }
     }
 
     // normalize weights
-    for (auto& p : params) {
-        if (!p.valid) {
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        if (!params.valid[i]) {
             continue;
         }
 
-        for (index_t y = p.bounds.ymin; y <= p.bounds.ymax; ++y) {
-            for (index_t x = p.bounds.xmin; x <= p.bounds.xmax; ++x) {
+        auto const& b = params.bounds[i];
+        auto const w = params.weights(i);
+
+        for (index_t y = b.ymin; y <= b.ymax; ++y) {
+            for (index_t x = b.xmin; x <= b.xmax; ++x) {
                 if (total[{x, y}] > static_cast<T>(0)) {
-                    p.weights[{x - p.bounds.xmin, y - p.bounds.ymin}] /= total[{x, y}];
+                    w[{x - b.xmin, y - b.ymin}] /= total[{x, y}];
                 }
             }
         }
     }
 }
 
-} /* namespace impl */
-
-
-// TODO: vector as parameter container is not good... drops image memory when resized
-
 template<class T>
-void reserve(std::vector<Parameters<T>>& params, std::size_t n, index2_t size)
+auto has_converged(Vec2<T> const& mean_new, Mat2s<T> const& prec_new, Vec2<T> const& mean,
+                   Mat2s<T> const& prec, Vec2<T> const& scale, T tol) -> bool
 {
-    if (n > params.size()) {
-        params.resize(n, Parameters<T> {
-            false,
-            static_cast<T>(1),
-            { static_cast<T>(0), static_cast<T>(0) },
-            { static_cast<T>(1), static_cast<T>(0), static_cast<T>(1) },
-            { 0, -1, 0, -1 },
-            Image<T> { size },
-        });
-    }
-
-    for (auto& p : params) {
-        p.valid = false;
-    }
+    // change of the mean in pixels
+    auto const dx = std::abs(mean_new.x - mean.x) / scale.x;
+    auto const dy = std::abs(mean_new.y - mean.y) / scale.y;
+
+    // change of the precision matrix relative to its diagonal
+    auto const norm = std::max(std::abs(prec.xx), std::abs(prec.yy));
+    auto const dp = std::max({
+        std::abs(prec_new.xx - prec.xx),
+        std::abs(prec_new.xy - prec.xy),
+        std::abs(prec_new.yy - prec.yy),
+    });
+
+    return dx < tol && dy < tol && dp < tol * norm;
 }
 
-template<class T, class S>
-void fit(std::vector<Parameters<S>>& params, Image<T> const& data,
-         Image<S>& tmp, unsigned int n_iter, S eps=math::num<S>::eps)
+} /* namespace impl */
+
+
+/*
+ * Fits the given parameters to the data, starting from their current values. Stops after
+ * n_iter iterations, or as soon as no mean moves by tol pixels or more and no entry of a
+ * precision matrix changes by tol or more relative to its diagonal. Returns the number of
+ * iterations performed. The math policy M selects the implementation of exp() and log() in the
+ * inner loops, see math/fast.hpp.
+ */
+template<class M = math::fast::Std, class T, class S, std::size_t N>
+auto fit(Parameters<S, N>& params, Image<T> const& data, Image<S>& tmp, Grid<S> const& grid,
+         unsigned int n_iter, S tol=math::num<S>::zero, S eps=math::num<S>::eps) -> unsigned int
 {
     auto const scale = Vec2<S> {
         static_cast<S>(2) * range<S>.x / static_cast<S>(data.size().x),
@@ -250,69 +440,94 @@ void fit(std::vector<Parameters<S>>& params, Image<T> const& data,
     };
 
     // down-scaling
-    for (auto& p : params) {
-        if (!p.valid) {
+    for (std::size_t k = 0; k < params.size(); ++k) {
+        if (!params.valid[k]) {
             continue;
         }
 
+        auto& mean = params.mean[k];
+        auto& prec = params.prec[k];
+
         // scale and center mean
-        p.mean.x = p.mean.x * scale.x - range<S>.x;
-        p.mean.y = p.mean.y * scale.y - range<S>.y;
+        mean.x = mean.x * scale.x - range<S>.x;
+        mean.y = mean.y * scale.y - range<S>.y;
 
         // scale precision matrix (compute (S * Sigma * S^T)^-1 = S^-T * Prec * S^-1)
-        p.prec.xx = p.prec.xx / (scale.x * scale.x);
-        p.prec.xy = p.prec.xy / (scale.x * scale.y);
-        p.prec.yy = p.prec.yy / (scale.y * scale.y);
+        prec.xx = prec.xx / (scale.x * scale.x);
+        prec.xy = prec.xy / (scale.x * scale.y);
+        prec.yy = prec.yy / (scale.y * scale.y);
     }
 
     // perform iterations
-    for (unsigned int i = 0; i < n_iter; ++i) {
+    unsigned int i = 0;
+    while (i < n_iter) {
+        bool converged = true;
+        ++i;
+
         // update weights
-        impl::update_weight_maps(params, tmp);
+        impl::update_weight_maps<M>(params, tmp, grid);
 
         // fit individual parameters
-        for (auto& p : params) {
+        for (std::size_t k = 0; k < params.size(); ++k) {
             auto sys = Mat6<S>{};
             auto rhs = Vec6<S>{};
             auto chi = Vec6<S>{};
 
-            if (!p.valid) {
+            if (!params.valid[k]) {
                 continue;
             }
 
+            auto const mean = params.mean[k];
+            auto const prec = params.prec[k];
+
             // assemble system of linear equations
-            impl::assemble_system(sys, rhs, p.bounds, data, p.weights);
+            impl::assemble_system<M>(sys, rhs, params.bounds[k], data, std::as_const(params).weights(k), grid);
 
             // solve systems
-            p.valid = math::ge_solve(sys, rhs, chi, eps);
-            if (!p.valid) {
+            params.valid[k] = math::ldlt_solve(sys, rhs, chi, eps);
+            if (!params.valid[k]) {
                 spdlog::warn("invalid equation system");
                 continue;
             }
 
+            // the system has been solved for the coefficient of xy, but we need the one of 2xy
+            chi[1] /= static_cast<S>(2);
+
             // get parameters
-            p.valid = impl::extract_params(chi, p.scale, p.mean, p.prec, eps);
-            if (!p.valid) {
+            params.valid[k] = impl::extract_params(chi, params.scale[k], params.mean[k], params.prec[k], eps);
+            if (!params.valid[k]) {
                 spdlog::warn("parameter extraction failed");
+                continue;
             }
+
+            converged = converged && impl::has_converged(params.mean[k], params.prec[k], mean, prec, scale, tol);
+        }
+
+        if (converged) {
+            break;
         }
     }
 
     // undo down-scaling
-    for (auto& p : params) {
-        if (!p.valid) {
+    for (std::size_t k = 0; k < params.size(); ++k) {
+        if (!params.valid[k]) {
             continue;
         }
 
+        auto& mean = params.mean[k];
+        auto& prec = params.prec[k];
+
         // un-scale and re-adjust mean
-        p.mean.x = (p.mean.x + range<S>.x) / scale.x;
-        p.mean.y = (p.mean.y + range<S>.y) / scale.y;
+        mean.x = (mean.x + range<S>.x) / scale.x;
+        mean.y = (mean.y + range<S>.y) / scale.y;
 
         // un-scale precision matrix
-        p.prec.xx = p.prec.xx * scale.x * scale.x;
-        p.prec.xy = p.prec.xy * scale.x * scale.y;
-        p.prec.yy = p.prec.yy * scale.y * scale.y;
+        prec.xx = prec.xx * scale.x * scale.x;
+        prec.xy = prec.xy * scale.x * scale.y;
+        prec.yy = prec.yy * scale.y * scale.y;
     }
+
+    return i;
 }
 
 } /* namespace iptsd::contacts::advanced::alg::gfit */
@@ -4,6 +4,7 @@
 
 #include <container/image.hpp>
 #include <container/kernel.hpp>
+#include <container/tensor_image.hpp>
 
 #include "border.hpp"
 #include "convolution.hpp"
@@ -71,4 +72,14 @@ void hessian(Image<Mat2s<T>>& out, Image<T> const& in)
     }
 }
 
+template<typename B=border::Zero, typename T>
+void hessian(TensorImage<T>& out, Image<T> const& in)
+{
+    static_assert(std::is_same_v<B, border::Zero>, "planar hessian only supports zero borders");
+
+    assert(in.size() == out.size());
+
+    hess::impl::hessian_zero<T>(out, in);
+}
+
 } /* namespace iptsd::contacts::advanced::alg */
@@ -87,8 +87,8 @@ inline auto resolve(Image<UInt16>& forest, UInt16 background) -> UInt16
     return n_labels;
 }
 
-template<typename T>
-inline auto find_background(Image<T> const& data, T threshold) -> UInt16
+template<typename D>
+inline auto find_background(D const& data, typename D::value_type threshold) -> UInt16
 {
     for (index_t i = 0; i < data.size().span(); ++i) {
         if (data[i] <= threshold) {
@@ -101,8 +101,12 @@ inline auto find_background(Image<T> const& data, T threshold) -> UInt16
 
 } /* namespace impl */
 
-template<int C=4, typename T>
-auto label(Image<UInt16>& out, Image<T> const& data, T threshold) -> UInt16
+/*
+ * Labels the connected components of pixels above the threshold. The data can be an image or
+ * an element-wise expression (see container::ops), which is then evaluated on the fly.
+ */
+template<int C=4, typename D>
+auto label(Image<UInt16>& out, D const& data, typename D::value_type threshold) -> UInt16
 {
     static_assert(C == 4 || C == 8);
 
@@ -110,6 +110,8 @@ void conv_3x3_extend(Image<T>& out, Image<T> const& data, Kernel<S, 3, 3> const&
 
         // 0 < x < n
         auto const limit = i + data.size().x - 2;
+        i = simd::conv_interior(out, data, kern, i, limit);
+
         while (i < limit) {
             T v = math::num<T>::zero;
 
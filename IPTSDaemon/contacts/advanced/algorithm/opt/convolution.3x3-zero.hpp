@@ -0,0 +1,92 @@
+/*
+ * Optimized version of convolution.hpp. Do not include directly.
+ */
+
+#include "../convolution.hpp"
+
+
+namespace iptsd::contacts::advanced::alg::conv::impl {
+
+template<typename T, typename S>
+void conv_3x3_zero(Image<T>& out, Image<T> const& data, Kernel<S, 3, 3> const& kern)
+{
+    index_t const w = data.size().x;
+    index_t const h = data.size().y;
+
+    // strides
+    auto const stride_d = data.stride();
+    auto const stride_k = kern.stride();
+
+    // access helpers
+    auto const k = [&](index_t dx, index_t dy) constexpr -> S {
+        return common::unchecked<S>(kern, 4 + dy * stride_k + dx);
+    };
+
+    auto const d = [&](index_t i, index_t dx, index_t dy) constexpr -> T {
+        return common::unchecked<T>(data, i + dy * stride_d + dx);
+    };
+
+    // border pixels, terms outside of the image are skipped
+    auto const border = [&](index_t x, index_t y) -> T {
+        T v = math::num<T>::zero;
+
+        index_t const dx0 = x > 0 ? -1 : 0;
+        index_t const dx1 = x < w - 1 ? 1 : 0;
+        index_t const dy0 = y > 0 ? -1 : 0;
+        index_t const dy1 = y < h - 1 ? 1 : 0;
+
+        for (index_t dy = dy0; dy <= dy1; ++dy) {
+            for (index_t dx = dx0; dx <= dx1; ++dx) {
+                v += d(y * stride_d + x, dx, dy) * k(dx, dy);
+            }
+        }
+
+        return v;
+    };
+
+    for (index_t y = 0; y < h; ++y) {
+        index_t i = y * stride_d;
+
+        // y = 0, y = n - 1
+        if (y == 0 || y == h - 1) {
+            for (index_t x = 0; x < w; ++x) {
+                common::unchecked<T>(out, i + x) = border(x, y);
+            }
+
+            continue;
+        }
+
+        // x = 0
+        common::unchecked<T>(out, i) = border(0, y);
+        ++i;
+
+        // 0 < x < n - 1
+        auto const limit = y * stride_d + w - 1;
+        i = simd::conv_interior(out, data, kern, i, limit);
+
+        for (; i < limit; ++i) {
+            T v = math::num<T>::zero;
+
+            v += d(i, -1, -1) * k(-1, -1);
+            v += d(i,  0, -1) * k( 0, -1);
+            v += d(i,  1, -1) * k( 1, -1);
+
+            v += d(i, -1,  0) * k(-1,  0);
+            v += d(i,  0,  0) * k( 0,  0);
+            v += d(i,  1,  0) * k( 1,  0);
+
+            v += d(i, -1,  1) * k(-1,  1);
+            v += d(i,  0,  1) * k( 0,  1);
+            v += d(i,  1,  1) * k( 1,  1);
+
+            common::unchecked<T>(out, i) = v;
+        }
+
+        // x = n - 1
+        if (w > 1) {
+            common::unchecked<T>(out, i) = border(w - 1, y);
+        }
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg::conv::impl */
@@ -482,6 +482,8 @@ void conv_5x5_extend(Image<T>& out, Image<T> const& data, Kernel<S, 5, 5> const&
 
         // 1 < x < n - 2
         auto const limit = i + data.size().x - 4;
+        i = simd::conv_interior(out, data, kern, i, limit);
+
         while (i < limit) {
             T v = math::num<T>::zero;
 
@@ -0,0 +1,101 @@
+/*
+ * Optimized version of convolution.hpp. Do not include directly.
+ */
+
+#include "../convolution.hpp"
+
+
+namespace iptsd::contacts::advanced::alg::conv::impl {
+
+/*
+ * Convolution with a separable kernel k(x, y) = kx(x) * ky(y) and extended borders, as a
+ * vertical pass from the input into the output, followed by an in-place horizontal pass on
+ * the output. Needs Nx + Ny instead of Nx * Ny multiply-adds per pixel. The input and
+ * output must not alias.
+ */
+template<typename T, typename S, index_t Nx, index_t Ny>
+void conv_separable_extend(Image<T>& out, Image<T> const& in, Kernel<S, Nx, 1> const& kx,
+                           Kernel<S, 1, Ny> const& ky)
+{
+    static_assert(Nx % 2 == 1);
+    static_assert(Ny % 2 == 1);
+
+    index_t const dx = (Nx - 1) / 2;
+    index_t const dy = (Ny - 1) / 2;
+
+    index_t const w = in.size().x;
+    index_t const h = in.size().y;
+    index_t const stride = in.stride();
+
+    T const* src = in.data();
+    T* dst = out.data();
+
+    // vertical pass, rows outside of the image are replaced by the first/last row
+    for (index_t y = 0; y < h; ++y) {
+        std::array<T const*, Ny> rows;
+
+        for (index_t j = 0; j < Ny; ++j) {
+            rows[j] = src + std::clamp(y + j - dy, 0, h - 1) * stride;
+        }
+
+        T* row = dst + y * stride;
+
+        // rows that do not need extension can be handled by the vectorized code
+        index_t x = 0;
+        if (y >= dy && y < h - dy) {
+            x = simd::conv_interior(out, in, ky, y * stride, y * stride + w) - y * stride;
+        }
+
+        for (; x < w; ++x) {
+            T v = math::num<T>::zero;
+
+            for (index_t j = 0; j < Ny; ++j) {
+                v += rows[j][x] * common::unchecked<S>(ky, j);
+            }
+
+            row[x] = v;
+        }
+    }
+
+    // horizontal pass, in place, in chunks of nb pixels: the original values of a chunk and
+    // its neighbors are copied to a buffer first, which the chunk is then computed from
+    index_t constexpr nb = 64;
+
+    for (index_t y = 0; y < h; ++y) {
+        T* row = dst + y * stride;
+
+        std::array<T, nb + Nx - 1> buf;
+
+        // buf[j] holds the original value at x0 - dx + j
+        for (index_t j = 0; j < dx; ++j) {
+            buf[nb + j] = row[0];
+        }
+
+        for (index_t x0 = 0; x0 < w; x0 += nb) {
+            index_t const n = std::min(nb, w - x0);
+
+            // the left neighbors of this chunk are the last values of the previous one
+            for (index_t j = 0; j < dx; ++j) {
+                buf[j] = buf[nb + j];
+            }
+
+            for (index_t j = 0; j < n + dx; ++j) {
+                buf[dx + j] = row[std::min(x0 + j, w - 1)];
+            }
+
+            auto x = simd::conv_span(row + x0, buf.data() + dx, 0, kx, 0, n);
+
+            for (; x < n; ++x) {
+                T v = math::num<T>::zero;
+
+                for (index_t i = 0; i < Nx; ++i) {
+                    v += buf[x + i] * common::unchecked<S>(kx, i);
+                }
+
+                row[x0 + x] = v;
+            }
+        }
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg::conv::impl */
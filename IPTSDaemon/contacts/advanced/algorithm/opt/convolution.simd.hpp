@@ -0,0 +1,208 @@
+/*
+ * Optimized version of convolution.hpp. Do not include directly.
+ */
+
+#include "../convolution.hpp"
+
+#include <common/simd.hpp>
+#include <math/mat2.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+
+namespace iptsd::contacts::advanced::alg::conv::impl::simd {
+
+/*
+ * Number of Float32 components of a pixel type that can be convolved component-wise, or
+ * zero if the type is not supported by the vectorized code paths.
+ */
+template<typename T>
+struct lanes : std::integral_constant<index_t, 0> {};
+
+template<>
+struct lanes<Float32> : std::integral_constant<index_t, 1> {};
+
+template<>
+struct lanes<Mat2s<Float32>> : std::integral_constant<index_t, 3> {};
+
+
+using v4f = common::simd::f32x4;
+
+#if defined(__x86_64__) || defined(__i386__)
+using v8f = common::simd::f32x8;
+#endif
+
+/*
+ * Computes the U vectors of the Nk outputs starting at component j as sums over the kernel
+ * window, one kernel per output, sizeof(V) / 4 components per vector. Neighboring pixels are
+ * lx components apart, neighboring rows ly components. Each input vector is loaded once for
+ * all kernels, and the terms are added in the same order as in the scalar code. The U vectors
+ * are independent, so that their additions can overlap. The outputs must not alias the input.
+ */
+template<typename V, index_t U, index_t Nk, index_t Nx, index_t Ny>
+[[gnu::always_inline]] inline void conv_vectors(Float32* const* out, Float32 const* in,
+                                                index_t j, index_t lx, index_t ly,
+                                                Float32 const* const* k)
+{
+    index_t constexpr n = sizeof(V) / sizeof(Float32);
+
+    index_t const dx = (Nx - 1) / 2;
+    index_t const dy = (Ny - 1) / 2;
+
+    V v[Nk][U] = {};
+
+    // fully unrolled, so that the accumulators stay in registers
+#pragma GCC unroll 8
+    for (index_t iy = 0; iy < Ny; ++iy) {
+#pragma GCC unroll 8
+        for (index_t ix = 0; ix < Nx; ++ix) {
+            auto const* const src = in + j + (ix - dx) * lx + (iy - dy) * ly;
+
+#pragma GCC unroll 8
+            for (index_t u = 0; u < U; ++u) {
+                V x;
+                std::memcpy(&x, src + u * n, sizeof(V));
+
+#pragma GCC unroll 8
+                for (index_t c = 0; c < Nk; ++c) {
+                    v[c][u] += x * k[c][iy * Nx + ix];
+                }
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (index_t c = 0; c < Nk; ++c) {
+#pragma GCC unroll 8
+        for (index_t u = 0; u < U; ++u) {
+            std::memcpy(out[c] + j + u * n, &v[c][u], sizeof(V));
+        }
+    }
+}
+
+/*
+ * Computes the components [begin, end) of the Nk outputs, U vectors at a time, see
+ * conv_vectors(). Returns the first component that has not been computed.
+ */
+template<typename V, index_t U, index_t Nk, index_t Nx, index_t Ny>
+[[gnu::always_inline]] inline auto conv_block(Float32* const* out, Float32 const* in,
+                                              index_t begin, index_t end, index_t lx,
+                                              index_t ly, Float32 const* const* k) -> index_t
+{
+    index_t constexpr n = sizeof(V) / sizeof(Float32);
+
+    index_t j = begin;
+
+    for (; j + U * n <= end; j += U * n) {
+        conv_vectors<V, U, Nk, Nx, Ny>(out, in, j, lx, ly, k);
+    }
+
+    // the rest one vector at a time
+    for (; U > 1 && j + n <= end; j += n) {
+        conv_vectors<V, 1, Nk, Nx, Ny>(out, in, j, lx, ly, k);
+    }
+
+    if (j < end && end - begin >= n) {
+        // cover the rest with one more vector overlapping the last one, the overlapping
+        // components are simply computed twice
+        conv_vectors<V, 1, Nk, Nx, Ny>(out, in, end - n, lx, ly, k);
+        j = end;
+    }
+
+    return j;
+}
+
+// number of vectors computed at once, fewer with more kernels to stay within the registers
+template<index_t Nk>
+inline constexpr index_t block_size = Nk < 4 ? 4 / Nk : 1;
+
+#if defined(__x86_64__) || defined(__i386__)
+template<index_t Nk, index_t Nx, index_t Ny>
+__attribute__((target("avx2")))
+auto conv_avx2(Float32* const* out, Float32 const* in, index_t begin, index_t end, index_t lx,
+               index_t ly, Float32 const* const* k) -> index_t
+{
+    return conv_block<v8f, block_size<Nk>, Nk, Nx, Ny>(out, in, begin, end, lx, ly, k);
+}
+#endif
+
+template<index_t Nk, index_t Nx, index_t Ny>
+auto conv_v4(Float32* const* out, Float32 const* in, index_t begin, index_t end, index_t lx,
+             index_t ly, Float32 const* const* k) -> index_t
+{
+    return conv_block<v4f, block_size<Nk>, Nk, Nx, Ny>(out, in, begin, end, lx, ly, k);
+}
+
+/*
+ * Convolves the pixels [begin, end) of a buffer with the given row stride with each of the Nk
+ * kernels, writing to the same pixels of the corresponding output, with the instruction set
+ * selected at startup. Returns the first pixel that still has to be computed by the scalar
+ * code. All pixels in the range must be far enough from the border of the buffer to not need
+ * extension.
+ */
+template<typename T, typename S, std::size_t Nk, index_t Nx, index_t Ny>
+auto conv_bank_span(std::array<T*, Nk> const& out, T const* in, index_t stride,
+                    std::array<Kernel<S, Nx, Ny> const*, Nk> const& k, index_t begin,
+                    index_t end) -> index_t
+{
+    if constexpr (lanes<T>::value == 0 || !std::is_same_v<S, Float32>) {
+        return begin;
+    } else {
+        index_t constexpr l = lanes<T>::value;
+
+        std::array<Float32*, Nk> o;
+        std::array<Float32 const*, Nk> kd;
+
+        for (std::size_t c = 0; c < Nk; ++c) {
+            o[c] = reinterpret_cast<Float32*>(out[c]);
+            kd[c] = k[c]->data();
+        }
+
+        auto const* const i = reinterpret_cast<Float32 const*>(in);
+
+        index_t j = begin * l;
+
+        switch (common::simd::isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+        case common::simd::Isa::avx2:
+            j = conv_avx2<index_t{Nk}, Nx, Ny>(o.data(), i, begin * l, end * l, l, stride * l, kd.data());
+            break;
+#endif
+        case common::simd::Isa::sse2:
+        case common::simd::Isa::neon:
+            j = conv_v4<index_t{Nk}, Nx, Ny>(o.data(), i, begin * l, end * l, l, stride * l, kd.data());
+            break;
+
+        default:
+            break;
+        }
+
+        // a pixel may have been computed partially, the scalar code just computes it again
+        return j / l;
+    }
+}
+
+/*
+ * Same as conv_bank_span(), for a single kernel.
+ */
+template<typename T, typename S, index_t Nx, index_t Ny>
+auto conv_span(T* out, T const* in, index_t stride, Kernel<S, Nx, Ny> const& k, index_t begin,
+               index_t end) -> index_t
+{
+    return conv_bank_span<T, S, 1, Nx, Ny>({out}, in, stride, {&k}, begin, end);
+}
+
+/*
+ * Same as conv_span(), for the pixels [begin, end) of an image.
+ */
+template<typename T, typename S, index_t Nx, index_t Ny>
+auto conv_interior(Image<T>& out, Image<T> const& in, Kernel<S, Nx, Ny> const& k,
+                   index_t begin, index_t end) -> index_t
+{
+    return conv_span(out.data(), in.data(), in.stride(), k, begin, end);
+}
+
+} /* namespace iptsd::contacts::advanced::alg::conv::impl::simd */
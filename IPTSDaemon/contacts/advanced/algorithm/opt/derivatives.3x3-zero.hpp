@@ -0,0 +1,125 @@
+/*
+ * Optimized version of derivatives.hpp. Do not include directly.
+ */
+
+#include "../derivatives.hpp"
+
+
+namespace iptsd::contacts::advanced::alg::deriv::impl {
+
+template<typename T>
+void derivatives_3x3_zero(TensorImage<T>& st, TensorImage<T>& hs, Image<T> const& in)
+{
+    index_t constexpr nk = 5;
+
+    index_t const w = in.size().x;
+    index_t const h = in.size().y;
+
+    // the gradients are stored in the xx and yy planes of the structure tensor for now
+    auto const out = std::array<T*, nk> {
+        st.xx().data(), st.yy().data(), hs.xx().data(), hs.xy().data(), hs.yy().data(),
+    };
+
+    auto const kern = std::array<Kernel<T, 3, 3> const*, nk> {
+        &conv::kernels::sobel3_x<T>,
+        &conv::kernels::sobel3_y<T>,
+        &conv::kernels::sobel3_xx<T>,
+        &conv::kernels::sobel3_xy<T>,
+        &conv::kernels::sobel3_yy<T>,
+    };
+
+    // strides
+    auto const stride_d = in.stride();
+
+    // kernel values, interleaved so that the values of one term are next to each other
+    std::array<T, 9 * nk> kv;
+
+    for (index_t j = 0; j < 9; ++j) {
+        for (index_t c = 0; c < nk; ++c) {
+            kv[j * nk + c] = common::unchecked<T>(*kern[c], j);
+        }
+    }
+
+    // access helpers
+    auto const k = [&](index_t c, index_t dx, index_t dy) constexpr -> T {
+        return kv[(4 + dy * 3 + dx) * nk + c];
+    };
+
+    auto const d = [&](index_t i, index_t dx, index_t dy) constexpr -> T {
+        return common::unchecked<T>(in, i + dy * stride_d + dx);
+    };
+
+    // computes all derivatives at one pixel, terms outside of the image are skipped
+    auto const pixel = [&](index_t x, index_t y) {
+        index_t const i = y * stride_d + x;
+
+        index_t const dx0 = x > 0 ? -1 : 0;
+        index_t const dx1 = x < w - 1 ? 1 : 0;
+        index_t const dy0 = y > 0 ? -1 : 0;
+        index_t const dy1 = y < h - 1 ? 1 : 0;
+
+        std::array<T, nk> v;
+        v.fill(math::num<T>::zero);
+
+        for (index_t dy = dy0; dy <= dy1; ++dy) {
+            for (index_t dx = dx0; dx <= dx1; ++dx) {
+                auto const value = d(i, dx, dy);
+
+#pragma GCC unroll 8
+                for (index_t c = 0; c < nk; ++c) {
+                    v[c] += value * k(c, dx, dy);
+                }
+            }
+        }
+
+#pragma GCC unroll 8
+        for (index_t c = 0; c < nk; ++c) {
+            out[c][i] = v[c];
+        }
+    };
+
+    for (index_t y = 0; y < h; ++y) {
+        // y = 0, y = n - 1
+        if (y == 0 || y == h - 1) {
+            for (index_t x = 0; x < w; ++x) {
+                pixel(x, y);
+            }
+
+            continue;
+        }
+
+        // x = 0
+        pixel(0, y);
+
+        // 0 < x < n - 1
+        auto const begin = y * stride_d + 1;
+        auto const limit = y * stride_d + w - 1;
+
+        auto const i = conv::impl::simd::conv_bank_span(out, in.data(), stride_d, kern, begin, limit);
+
+        for (index_t x = i - y * stride_d; x < w - 1; ++x) {
+            pixel(x, y);
+        }
+
+        // x = n - 1
+        if (w > 1) {
+            pixel(w - 1, y);
+        }
+    }
+
+    // structure tensor from the gradients
+    T* const xx = st.xx().data();
+    T* const xy = st.xy().data();
+    T* const yy = st.yy().data();
+
+    for (index_t i = 0; i < in.size().span(); ++i) {
+        auto const gx = xx[i];
+        auto const gy = yy[i];
+
+        xx[i] = gx * gx;
+        xy[i] = gx * gy;
+        yy[i] = gy * gy;
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg::deriv::impl */
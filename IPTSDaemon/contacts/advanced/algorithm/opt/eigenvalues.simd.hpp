@@ -0,0 +1,177 @@
+/*
+ * Optimized version of eigenvalues.hpp. Do not include directly.
+ */
+
+#include "../eigenvalues.hpp"
+
+#include <common/simd.hpp>
+
+#include <cstring>
+#include <type_traits>
+
+
+namespace iptsd::contacts::advanced::alg::eigen::impl::simd {
+
+// the 8-wide blocks are only ever inlined into the AVX2 functions below
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+/*
+ * Vectorized versions of the closed forms in eigenvalues.hpp, sizeof(V) / 4 pixels at a time.
+ * They return the first pixel that has not been computed.
+ */
+template<typename V>
+[[gnu::always_inline]] inline void load(V& xx, V& xy, V& yy, Float32 const* const* in, index_t i)
+{
+    std::memcpy(&xx, in[0] + i, sizeof(V));
+    std::memcpy(&xy, in[1] + i, sizeof(V));
+    std::memcpy(&yy, in[2] + i, sizeof(V));
+}
+
+template<typename V>
+[[gnu::always_inline]] inline auto values_block(Float32* ev1, Float32* ev2,
+                                                Float32 const* const* in, index_t n) -> index_t
+{
+    index_t constexpr w = sizeof(V) / sizeof(Float32);
+
+    V const zero = {};
+
+    index_t i = 0;
+    for (; i + w <= n; i += w) {
+        V a, b, c;
+        load(a, b, c, in, i);
+
+        auto const d = a - c;
+        auto const t = a + c;
+        auto const s = common::simd::sqrt(d * d + 4.0f * b * b);
+        auto const det = a * c - b * b;
+
+        auto const v1 = common::simd::select(t >= zero, (t + s) / 2.0f, (t - s) / 2.0f);
+        auto const v2 = common::simd::select(v1 != zero, det / v1, zero);
+
+        std::memcpy(ev1 + i, &v1, sizeof(V));
+        std::memcpy(ev2 + i, &v2, sizeof(V));
+    }
+
+    return i;
+}
+
+template<typename V, bool Pos, bool Coh>
+[[gnu::always_inline]] inline auto features_block(Float32* pos, Float32* coh,
+                                                  Float32 const* const* in, index_t n) -> index_t
+{
+    index_t constexpr w = sizeof(V) / sizeof(Float32);
+
+    V const zero = {};
+    V const one = zero + 1.0f;
+
+    index_t i = 0;
+    for (; i + w <= n; i += w) {
+        V a, b, c;
+        load(a, b, c, in, i);
+
+        auto const d = a - c;
+        auto const t = a + c;
+        auto const s = common::simd::sqrt(d * d + 4.0f * b * b);
+
+        if constexpr (Pos) {
+            auto const det = a * c - b * b;
+            auto const tp = common::simd::select(t > zero, t, zero);
+            auto const v = common::simd::select(det >= zero, tp, (t + s) / 2.0f);
+
+            std::memcpy(pos + i, &v, sizeof(V));
+        }
+
+        if constexpr (Coh) {
+            auto const v = common::simd::select(t != zero, s / t, one);
+
+            std::memcpy(coh + i, &v, sizeof(V));
+        }
+    }
+
+    return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+inline auto values_avx2(Float32* ev1, Float32* ev2, Float32 const* const* in, index_t n) -> index_t
+{
+    return values_block<common::simd::f32x8>(ev1, ev2, in, n);
+}
+
+template<bool Pos, bool Coh>
+__attribute__((target("avx2")))
+auto features_avx2(Float32* pos, Float32* coh, Float32 const* const* in, index_t n) -> index_t
+{
+    return features_block<common::simd::f32x8, Pos, Coh>(pos, coh, in, n);
+}
+#endif
+
+inline auto values_v4(Float32* ev1, Float32* ev2, Float32 const* const* in, index_t n) -> index_t
+{
+    return values_block<common::simd::f32x4>(ev1, ev2, in, n);
+}
+
+template<bool Pos, bool Coh>
+auto features_v4(Float32* pos, Float32* coh, Float32 const* const* in, index_t n) -> index_t
+{
+    return features_block<common::simd::f32x4, Pos, Coh>(pos, coh, in, n);
+}
+
+/*
+ * Computes the first n pixels with the instruction set selected at startup, and returns the
+ * first pixel that still has to be computed by the scalar code.
+ */
+template<typename T>
+auto values(T* ev1, T* ev2, TensorImage<T> const& in, index_t n) -> index_t
+{
+    if constexpr (!std::is_same_v<T, Float32>) {
+        return 0;
+    } else {
+        Float32 const* planes[3] = { in.xx().data(), in.xy().data(), in.yy().data() };
+
+        switch (common::simd::isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+        case common::simd::Isa::avx2:
+            return values_avx2(ev1, ev2, planes, n);
+#endif
+        case common::simd::Isa::sse2:
+        case common::simd::Isa::neon:
+            return values_v4(ev1, ev2, planes, n);
+
+        default:
+            return 0;
+        }
+    }
+}
+
+template<bool Pos, bool Coh, typename T>
+auto features(T* pos, T* coh, TensorImage<T> const& in, index_t n) -> index_t
+{
+    if constexpr (!std::is_same_v<T, Float32>) {
+        return 0;
+    } else {
+        Float32 const* planes[3] = { in.xx().data(), in.xy().data(), in.yy().data() };
+
+        switch (common::simd::isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+        case common::simd::Isa::avx2:
+            return features_avx2<Pos, Coh>(pos, coh, planes, n);
+#endif
+        case common::simd::Isa::sse2:
+        case common::simd::Isa::neon:
+            return features_v4<Pos, Coh>(pos, coh, planes, n);
+
+        default:
+            return 0;
+        }
+    }
+}
+
+} /* namespace iptsd::contacts::advanced::alg::eigen::impl::simd */
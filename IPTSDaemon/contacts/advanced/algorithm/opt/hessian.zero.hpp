@@ -300,4 +300,15 @@ void hessian_zero(Image<Mat2s<T>>& out, Image<T> const& in)
     }
 }
 
+/*
+ * Planar version: each component is a separate scalar convolution with zero borders.
+ */
+template<typename T>
+void hessian_zero(TensorImage<T>& out, Image<T> const& in)
+{
+    conv::impl::conv_3x3_zero<T, T>(out.xx(), in, conv::kernels::sobel3_xx<T>);
+    conv::impl::conv_3x3_zero<T, T>(out.xy(), in, conv::kernels::sobel3_xy<T>);
+    conv::impl::conv_3x3_zero<T, T>(out.yy(), in, conv::kernels::sobel3_yy<T>);
+}
+
 } /* namespace iptsd::contacts::advanced::alg::hess::impl */
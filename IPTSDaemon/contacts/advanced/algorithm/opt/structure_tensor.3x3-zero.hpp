@@ -259,4 +259,34 @@ void structure_tensor_3x3_zero(Image<Mat2s<T>>& out, Image<T> const& in,
     }
 }
 
+/*
+ * Planar version: the gradients are computed as two scalar convolutions into the xx and yy
+ * planes, which are then turned into the tensor components in one pass over the planes.
+ */
+template<typename T>
+void structure_tensor_3x3_zero(TensorImage<T>& out, Image<T> const& in,
+                               Kernel<T, 3, 3> const& kx, Kernel<T, 3, 3> const& ky)
+{
+    assert(in.size() == out.size());
+
+    auto& gx = out.xx();
+    auto& gy = out.yy();
+
+    conv::impl::conv_3x3_zero<T, T>(gx, in, kx);
+    conv::impl::conv_3x3_zero<T, T>(gy, in, ky);
+
+    T* const xx = out.xx().data();
+    T* const xy = out.xy().data();
+    T* const yy = out.yy().data();
+
+    for (index_t i = 0; i < in.size().span(); ++i) {
+        auto const x = xx[i];
+        auto const y = yy[i];
+
+        xx[i] = x * x;
+        xy[i] = x * y;
+        yy[i] = y * y;
+    }
+}
+
 } /* namespace iptsd::contacts::advanced::alg::stensor::impl */
@@ -7,6 +7,7 @@
 
 #include <container/image.hpp>
 #include <container/kernel.hpp>
+#include <container/tensor_image.hpp>
 
 #include <math/num.hpp>
 #include <math/mat2.hpp>
@@ -66,4 +67,17 @@ void structure_tensor(Image<Mat2s<T>>& out, Image<T> const& in,
     }
 }
 
+template<typename Bx=border::Zero, typename By=border::Zero, typename T, index_t Nx=3, index_t Ny=3>
+void structure_tensor(TensorImage<T>& out, Image<T> const& in,
+                      Kernel<T, Nx, Ny> const& kx=conv::kernels::sobel3_x<T>,
+                      Kernel<T, Nx, Ny> const& ky=conv::kernels::sobel3_y<T>)
+{
+    static_assert(Nx == 3 && Ny == 3 && std::is_same_v<Bx, border::Zero> && std::is_same_v<By, border::Zero>,
+                  "planar structure tensor only supports 3x3 kernels with zero borders");
+
+    assert(in.size() == out.size());
+
+    stensor::impl::structure_tensor_3x3_zero<T>(out, in, kx, ky);
+}
+
 } /* namespace iptsd::contacts::advanced::alg */
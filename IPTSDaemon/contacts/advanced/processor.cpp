@@ -3,26 +3,30 @@
 #include <common/types.hpp>
 
 #include "algorithm/convolution.hpp"
+#include "algorithm/derivatives.hpp"
 #include "algorithm/distance_transform.hpp"
+#include "algorithm/eigenvalues.hpp"
 #include "algorithm/gaussian_fitting.hpp"
-#include "algorithm/hessian.hpp"
 #include "algorithm/label.hpp"
 #include "algorithm/local_maxima.hpp"
-#include "algorithm/structure_tensor.hpp"
 
+#include <container/arena.hpp>
 #include <container/image.hpp>
 #include <container/kernel.hpp>
 #include <container/ops.hpp>
+#include <container/tensor_image.hpp>
 
 #include "../eval/perf.hpp"
 
 #include <gsl/util>
+#include <math/fast.hpp>
 #include <math/num.hpp>
 #include <math/vec2.hpp>
 #include <math/mat2.hpp>
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <queue>
@@ -30,18 +34,50 @@
 using namespace iptsd::container;
 using namespace iptsd::math;
 
+namespace ops = iptsd::container::ops;
+
 
 namespace iptsd::contacts::advanced {
 
-TouchProcessor::TouchProcessor(index2_t size)
+// cost per unit of distance and maximum distance of the weighted distance transform
+static constexpr Float32 wdt_c_dist = 0.1f;
+static constexpr Float32 wdt_limit = 6.0f;
+
+// maximum number of iterations and convergence tolerance of the gaussian fitting, and the
+// distance in pixels up to which a fit of the last frame is used as initial guess
+static constexpr unsigned int gfit_n_iter = 3;
+static constexpr Float64 gfit_tol = 0.01;
+static constexpr Float64 gfit_seed_radius = 2.0;
+
+// stages of process(), in order, for the lifetimes of the scratch images
+namespace stage {
+enum : index_t {
+    prep,
+    drv,
+    st,
+    stev,
+    hess,
+    rdg,
+    lmax,
+    lbl,
+    cscr,
+    wdt,
+    flt,
+    lmaxf,
+    gfit,
+    output,
+};
+} /* namespace stage */
+
+TouchProcessor::TouchProcessor(index2_t size, bool approx_math)
     : m_perf_reg{}
     , m_perf_t_total{m_perf_reg.create_entry("total")}
     , m_perf_t_prep{m_perf_reg.create_entry("preprocessing")}
+    , m_perf_t_drv{m_perf_reg.create_entry("derivatives")}
     , m_perf_t_st{m_perf_reg.create_entry("structure-tensor")}
     , m_perf_t_stev{m_perf_reg.create_entry("structure-tensor.eigenvalues")}
     , m_perf_t_hess{m_perf_reg.create_entry("hessian")}
     , m_perf_t_rdg{m_perf_reg.create_entry("ridge")}
-    , m_perf_t_obj{m_perf_reg.create_entry("objective")}
     , m_perf_t_lmax{m_perf_reg.create_entry("objective.maximas")}
     , m_perf_t_lbl{m_perf_reg.create_entry("labels")}
     , m_perf_t_cscr{m_perf_reg.create_entry("component-score")}
@@ -49,40 +85,127 @@ TouchProcessor::TouchProcessor(index2_t size)
     , m_perf_t_flt{m_perf_reg.create_entry("filter")}
     , m_perf_t_lmaxf{m_perf_reg.create_entry("filter.maximas")}
     , m_perf_t_gfit{m_perf_reg.create_entry("gaussian-fitting")}
-    , m_hm{size}
-    , m_img_pp{size}
-    , m_img_m2_1{size}
-    , m_img_m2_2{size}
-    , m_img_stev{size}
-    , m_img_rdg{size}
-    , m_img_obj{size}
-    , m_img_lbl{size}
-    , m_img_dm1{size}
-    , m_img_dm2{size}
-    , m_img_flt{size}
-    , m_img_gftmp{size}
+    , m_perf_c_gfit_iter{m_perf_reg.create_counter("gaussian-fitting.iterations")}
+    , m_arena{}
+    , m_hm{}
+    , m_img_pp{}
+    , m_img_m2_1{}
+    , m_img_m2_2{}
+    , m_img_m2_3{}
+    , m_img_stg{}
+    , m_img_stc{}
+    , m_img_rdg{}
+    , m_img_lbl{}
+    , m_img_dm{}
+    , m_img_flt{}
+    , m_img_gftmp{}
+#ifdef IPTSD_CONFIG_WDT_BINARY_HEAP
     , m_wdt_queue{}
-    , m_gf_params{}
-    , m_maximas{32}
-    , m_cstats{32}
-    , m_cscore{32}
-    , m_kern_pp{alg::conv::kernels::gaussian<Float32, 5, 5>(0.9f)}
-    , m_kern_st{alg::conv::kernels::gaussian<Float32, 5, 5>(1.0f)}
-    , m_kern_hs{alg::conv::kernels::gaussian<Float32, 5, 5>(1.0f)}
-    , m_gf_window{11, 11}
+#else
+    , m_wdt_queue{wdt_c_dist, wdt_limit}
+#endif
+    , m_gf_params{{11, 11}}
+    , m_gf_grid{size}
+    , m_gf_prev{}
+    , m_maximas{}
+    , m_cstats{}
+    , m_cscore{}
+    , m_kern_pp{alg::conv::kernels::gaussian_separable<Float32, 5, 5>(0.9f)}
+    , m_kern_st{alg::conv::kernels::gaussian_separable<Float32, 5, 5>(1.0f)}
+    , m_kern_hs{alg::conv::kernels::gaussian_separable<Float32, 5, 5>(1.0f)}
+    , m_approx_math{approx_math}
     , m_touchpoints{}
 {
-    m_wdt_queue = std::priority_queue { std::less<alg::wdt::QItem<Float32>>(), [](){
+    // scratch images with the first and last stage using them, images of the same type that
+    // are not used at the same time share memory
+    auto const n = size.span();
+
+    auto const s_hm  = m_arena.reserve<Float32>(n, stage::prep, stage::output);
+    auto const s_pp  = m_arena.reserve<Float32>(n, stage::prep, stage::gfit);
+    auto const s_stg = m_arena.reserve<Float32>(n, stage::stev, stage::wdt);
+    auto const s_stc = m_arena.reserve<Float32>(n, stage::stev, stage::cscr);
+    auto const s_rdg = m_arena.reserve<Float32>(n, stage::rdg, stage::wdt);
+    auto const s_flt = m_arena.reserve<Float32>(n, stage::flt, stage::gfit);
+
+    // raw structure tensor, smoothed structure tensor and hessian, raw hessian
+    std::array<std::array<Arena::slot, 3>, 3> s_m2;
+    std::array<std::array<index_t, 2>, 3> const m2_life { {
+        { stage::drv, stage::st },
+        { stage::st, stage::rdg },
+        { stage::drv, stage::hess },
+    } };
+
+    for (std::size_t i = 0; i < s_m2.size(); ++i) {
+        for (auto& p : s_m2[i]) {
+            p = m_arena.reserve<Float32>(n, m2_life[i][0], m2_life[i][1]);
+        }
+    }
+
+    auto const s_lbl   = m_arena.reserve<UInt16>(n, stage::lbl, stage::output);
+    auto const s_dm    = m_arena.reserve<alg::wdt::Dual<Float32>>(n, stage::wdt, stage::flt);
+    auto const s_gftmp = m_arena.reserve<Float64>(n, stage::gfit, stage::gfit);
+
+    m_arena.allocate();
+
+    auto const m2 = [&](std::size_t i) {
+        return TensorImage<Float32> {
+            m_arena.image<Float32>(s_m2[i][0], size),
+            m_arena.image<Float32>(s_m2[i][1], size),
+            m_arena.image<Float32>(s_m2[i][2], size),
+        };
+    };
+
+    m_hm        = m_arena.image<Float32>(s_hm, size);
+    m_img_pp    = m_arena.image<Float32>(s_pp, size);
+    m_img_m2_1  = m2(0);
+    m_img_m2_2  = m2(1);
+    m_img_m2_3  = m2(2);
+    m_img_stg   = m_arena.image<Float32>(s_stg, size);
+    m_img_stc   = m_arena.image<Float32>(s_stc, size);
+    m_img_rdg   = m_arena.image<Float32>(s_rdg, size);
+    m_img_lbl   = m_arena.image<UInt16>(s_lbl, size);
+    m_img_dm    = m_arena.image<alg::wdt::Dual<Float32>>(s_dm, size);
+    m_img_flt   = m_arena.image<Float32>(s_flt, size);
+    m_img_gftmp = m_arena.image<Float64>(s_gftmp, size);
+
+#ifdef IPTSD_CONFIG_WDT_BINARY_HEAP
+    m_wdt_queue = WdtQueue { std::greater<alg::wdt::QItem<Float32>>(), [&](){
         auto buf = std::vector<alg::wdt::QItem<Float32>>{};
-        buf.reserve(512);
+        buf.reserve(n);
         return buf;
     }() };
+#else
+    m_wdt_queue.reserve(n);
+#endif
+
+    // Neither two maximas nor two components can be direct neighbors, so there are at most
+    // half as many as pixels. Reserving that up front keeps process() off the heap, whatever
+    // the heatmap looks like.
+    m_maximas.reserve(n / 2 + 1);
+    m_cstats.reserve(n / 2 + 1);
+    m_cscore.reserve(n / 2 + 1);
+
+    m_gf_prev.reserve(gfit_max_contacts);
+    m_touchpoints.reserve(gfit_max_contacts);
+}
 
-    alg::gfit::reserve(m_gf_params, 32, size);
+auto TouchProcessor::process() -> std::vector<TouchPoint> const&
+{
+    if (m_approx_math) {
+        return process<math::fast::Approx>(m_hm);
+    }
 
-    m_touchpoints.reserve(32);
+    return process<math::fast::Std>(m_hm);
 }
 
+void TouchProcessor::idle()
+{
+    // warm starts only come from the frame right before, not from before the gap
+    m_gf_params.reset(0);
+    m_gf_prev.clear();
+}
+
+template<class M>
 auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint> const&
 {
     auto _tr = m_perf_reg.record(m_perf_t_total);
@@ -93,19 +216,24 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
 
         alg::convolve(m_img_pp, hm, m_kern_pp);
 
-        auto const sum = container::ops::sum(m_img_pp);
-        auto const avg = sum / m_img_pp.size().span();
+        // the average depends on all pixels, so this needs two passes
+        auto const pp = ops::ref(m_img_pp);
+        auto const avg = ops::sum(pp) / m_img_pp.size().span();
+
+        ops::assign(m_img_pp, ops::max(pp - avg, 0.0f));
+    }
+
+    // structure tensor and hessian, unsmoothed
+    {
+        auto _r = m_perf_reg.record(m_perf_t_drv);
 
-        container::ops::transform(m_img_pp, [&](auto const x) {
-            return std::max(x - avg, 0.0f);
-        });
+        alg::derivatives(m_img_m2_1, m_img_m2_3, m_img_pp);
     }
 
     // structure tensor
     {
         auto _r = m_perf_reg.record(m_perf_t_st);
 
-        alg::structure_tensor(m_img_m2_1, m_img_pp);
         alg::convolve(m_img_m2_2, m_img_m2_1, m_kern_st);
     }
 
@@ -113,39 +241,22 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
     {
         auto _r = m_perf_reg.record(m_perf_t_stev);
 
-        container::ops::transform(m_img_m2_2, m_img_stev, [](auto const s) {
-            return s.eigenvalues();
-        });
+        // only the gradient magnitude and the coherence are needed later on
+        alg::eigen_features(m_img_stg, m_img_stc, m_img_m2_2);
     }
 
     // hessian
     {
         auto _r = m_perf_reg.record(m_perf_t_hess);
 
-        alg::hessian(m_img_m2_1, m_img_pp);
-        alg::convolve(m_img_m2_2, m_img_m2_1, m_kern_hs);
+        alg::convolve(m_img_m2_2, m_img_m2_3, m_kern_hs);
     }
 
     // ridge measure
     {
         auto _r = m_perf_reg.record(m_perf_t_rdg);
 
-        container::ops::transform(m_img_m2_2, m_img_rdg, [](auto h) {
-            auto const [ev1, ev2] = h.eigenvalues();
-            return std::max(ev1, 0.0f) + std::max(ev2, 0.0f);
-        });
-    }
-
-    // objective for labeling
-    {
-        auto _r = m_perf_reg.record(m_perf_t_obj);
-
-        Float32 const wr = 1.5;
-        Float32 const wh = 1.0;
-
-        for (index_t i = 0; i < m_img_pp.size().span(); ++i) {
-            m_img_obj[i] = wh * m_img_pp[i] - wr * m_img_rdg[i];
-        }
+        alg::eigen_features(m_img_rdg, m_img_m2_2);
     }
 
     // local maximas
@@ -163,7 +274,13 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
     {
         auto _r = m_perf_reg.record(m_perf_t_lbl);
 
-        num_labels = alg::label<4>(m_img_lbl, m_img_obj, 0.0f);
+        Float32 const wr = 1.5;
+        Float32 const wh = 1.0;
+
+        // the objective is only needed here, so it is computed while labeling
+        auto const objective = wh * ops::ref(m_img_pp) - wr * ops::ref(m_img_rdg);
+
+        num_labels = alg::label<4>(m_img_lbl, objective, 0.0f);
     }
 
     // component score
@@ -180,9 +297,7 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
                 continue;
 
             auto const value = m_img_pp[i];
-            auto const [ev1, ev2] = m_img_stev[i];
-
-            auto const coherence = ev1 + ev2 != 0.0f ? (ev1 - ev2) / (ev1 + ev2) : 1.0;
+            auto const coherence = m_img_stc[i];
 
             m_cstats.at(label - 1).size += 1;
             m_cstats.at(label - 1).volume += value;
@@ -225,24 +340,29 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
     }
 
     // TODO: limit inclusion to N (e.g. N=16) local maximas by highest inclusion score
-    // TODO: if everything is excluded here, we can skip the rest
-    //       (useful to improve performance for touch sensor issues)
+
+    auto const th_inc = 0.6f;
+
+    // if everything is excluded, the filtered heatmap is zero and there is nothing to fit
+    if (std::none_of(m_cscore.begin(), m_cscore.end(), [&](auto const s) { return s > th_inc; })) {
+        idle();
+
+        m_touchpoints.clear();
+        return m_touchpoints;
+    }
 
     // distance transform
     {
         auto _r = m_perf_reg.record(m_perf_t_wdt);
 
-        auto const th_inc = 0.6f;
-
         auto const wdt_cost = [&](index_t i, index2_t d) -> Float32 {
-            Float32 const c_dist = 0.1f;
+            Float32 const c_dist = wdt_c_dist;
             Float32 const c_ridge = 9.0f;
             Float32 const c_grad = 1.0f;
 
-            auto const [ev1, ev2] = m_img_stev[i];
-            auto const grad = std::max(ev1, 0.0f) + std::max(ev2, 0.0f);
+            auto const grad = m_img_stg[i];
             auto const ridge = m_img_rdg[i];
-            auto const dist = std::sqrt(static_cast<Float32>(d.x * d.x + d.y * d.y));
+            auto const dist = M::sqrt(static_cast<Float32>(d.x * d.x + d.y * d.y));
 
             return c_ridge * ridge + c_grad * grad + c_dist * dist;
         };
@@ -259,28 +379,30 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
             return m_img_lbl[i] > 0 && m_cscore.at(m_img_lbl[i] - 1) <= th_inc;
         };
 
-        alg::weighted_distance_transform<4>(m_img_dm1, wdt_inc_bin, wdt_mask, wdt_cost, m_wdt_queue, 6.0f);
-        alg::weighted_distance_transform<4>(m_img_dm2, wdt_exc_bin, wdt_mask, wdt_cost, m_wdt_queue, 6.0f);
+        alg::weighted_distance_transform<4>(m_img_dm, wdt_inc_bin, wdt_exc_bin, wdt_mask, wdt_cost,
+                                            m_wdt_queue, wdt_limit);
     }
 
-    // filter
+    // filter, most pixels are far from any contact, where std::exp() takes its slow path
     {
         auto _r = m_perf_reg.record(m_perf_t_flt);
 
-        for (index_t i = 0; i < m_img_pp.size().span(); ++i) {
+        auto const weight = [](alg::wdt::Dual<Float32> const& dm) -> Float32 {
             auto const sigma = 1.0f;
 
-            auto w_inc = m_img_dm1[i] / sigma;
-            w_inc = std::exp(-w_inc * w_inc);
+            auto const [dm_inc, dm_exc] = dm.dist;
+
+            auto w_inc = dm_inc / sigma;
+            w_inc = M::exp(-w_inc * w_inc);
 
-            auto w_exc = m_img_dm2[i] / sigma;
-            w_exc = std::exp(-w_exc * w_exc);
+            auto w_exc = dm_exc / sigma;
+            w_exc = M::exp(-w_exc * w_exc);
 
             auto const w_total = w_inc + w_exc;
-            auto const w = w_total > 0.0f ? w_inc / w_total : 0.0f;
+            return w_total > 0.0f ? w_inc / w_total : 0.0f;
+        };
 
-            m_img_flt[i] = m_img_pp[i] * w;
-        }
+        ops::assign(m_img_flt, ops::ref(m_img_pp) * ops::map(weight, ops::ref(m_img_dm)));
     }
 
     // filtered maximas
@@ -291,47 +413,98 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
 
         m_maximas.clear();
         alg::find_local_maximas(m_img_flt, 0.05f, std::back_inserter(m_maximas));
+
+        // the parameter storage is fixed, keep the strongest maximas in their original order
+        if (m_maximas.size() > gfit_max_contacts) {
+            auto const stronger = [&](index_t a, index_t b) {
+                return m_img_flt[a] > m_img_flt[b] || (m_img_flt[a] == m_img_flt[b] && a < b);
+            };
+
+            std::nth_element(m_maximas.begin(), m_maximas.begin() + gfit_max_contacts - 1,
+                             m_maximas.end(), stronger);
+
+            m_maximas.resize(gfit_max_contacts);
+            std::sort(m_maximas.begin(), m_maximas.end());
+        }
     }
 
     // gaussian fitting
     if (!m_maximas.empty()) {
         auto _r = m_perf_reg.record(m_perf_t_gfit);
 
-        alg::gfit::reserve(m_gf_params, m_maximas.size(), m_gf_window);
+        // keep the fits of the last frame as initial guesses for the contacts of this one
+        m_gf_prev.clear();
+        for (std::size_t i = 0; i < m_gf_params.size(); ++i) {
+            auto const& prec = m_gf_params.prec[i];
+
+            if (m_gf_params.valid[i] && prec.xx > 0.0 && prec.det() > 0.0) {
+                m_gf_prev.push_back(FitSeed { m_gf_params.scale[i], m_gf_params.mean[i], prec, false });
+            }
+        }
+
+        m_gf_params.reset(m_maximas.size());
+
+        auto const window = m_gf_params.window();
 
         for (std::size_t i = 0; i < m_maximas.size(); ++i) {
             auto const [x, y] = Image<Float32>::unravel(m_img_pp.size(), m_maximas[i]);
 
             // TODO: move window inwards instead of clamping?
             auto const bounds = alg::gfit::BBox {
-                std::max(x - (m_gf_window.x - 1) / 2, 0),
-                std::min(x + (m_gf_window.x - 1) / 2, m_img_pp.size().x - 1),
-                std::max(y - (m_gf_window.y - 1) / 2, 0),
-                std::min(y + (m_gf_window.y - 1) / 2, m_img_pp.size().y - 1),
+                std::max(x - (window.x - 1) / 2, 0),
+                std::min(x + (window.x - 1) / 2, m_img_pp.size().x - 1),
+                std::max(y - (window.y - 1) / 2, 0),
+                std::min(y + (window.y - 1) / 2, m_img_pp.size().y - 1),
             };
 
-            m_gf_params[i].valid  = true;
-            m_gf_params[i].scale  = 1.0f;
-            m_gf_params[i].mean   = { static_cast<Float32>(x), static_cast<Float32>(y) };
-            m_gf_params[i].prec   = { 1.0f, 0.0f, 1.0f };
-            m_gf_params[i].bounds = bounds;
+            m_gf_params.valid[i]  = true;
+            m_gf_params.scale[i]  = 1.0f;
+            m_gf_params.mean[i]   = { static_cast<Float32>(x), static_cast<Float32>(y) };
+            m_gf_params.prec[i]   = { 1.0f, 0.0f, 1.0f };
+            m_gf_params.bounds[i] = bounds;
+
+            // start from the closest fit of the last frame, if the contact has barely moved
+            FitSeed* seed = nullptr;
+            auto seed_dist = gfit_seed_radius * gfit_seed_radius;
+
+            for (auto& s : m_gf_prev) {
+                auto const d = s.mean - m_gf_params.mean[i];
+                auto const dist = d.x * d.x + d.y * d.y;
+
+                if (!s.used && dist <= seed_dist) {
+                    seed = &s;
+                    seed_dist = dist;
+                }
+            }
+
+            if (seed) {
+                seed->used = true;
+
+                m_gf_params.scale[i] = seed->scale;
+                m_gf_params.mean[i]  = seed->mean;
+                m_gf_params.prec[i]  = seed->prec;
+            }
         }
 
-        alg::gfit::fit(m_gf_params, m_img_flt, m_img_gftmp, 3);
+        // the inputs of exp() and log() in the fit are always in range, where the Float64
+        // functions of the standard library are faster than the approximations
+        auto const n_iter = alg::gfit::fit<math::fast::Std>(m_gf_params, m_img_flt, m_img_gftmp, m_gf_grid,
+                                           gfit_n_iter, gfit_tol);
+
+        m_perf_reg.count(m_perf_c_gfit_iter, n_iter);
     } else {
-        for (auto& p : m_gf_params) {
-            p.valid = false;
-        }
+        idle();
     }
 
     // generate output
     m_touchpoints.clear();
-    for (auto const& p : m_gf_params) {
-        if (!p.valid) {
+    for (std::size_t i = 0; i < m_gf_params.size(); ++i) {
+        if (!m_gf_params.valid[i]) {
             continue;
         }
 
-        auto const cov = p.prec.inverse();
+        auto const& pos = m_gf_params.mean[i];
+        auto const cov = m_gf_params.prec[i].inverse();
         if (!cov.has_value()) {
             spdlog::warn("failed to invert matrix");
             continue;
@@ -351,15 +524,15 @@ auto TouchProcessor::process(Image<Float32> const& hm) -> std::vector<TouchPoint
             continue;
         }
 
-        auto const x = std::clamp(static_cast<index_t>(p.mean.x), 0, m_img_lbl.size().x - 1);
-        auto const y = std::clamp(static_cast<index_t>(p.mean.y), 0, m_img_lbl.size().y - 1);
+        auto const x = std::clamp(static_cast<index_t>(pos.x), 0, m_img_lbl.size().x - 1);
+        auto const y = std::clamp(static_cast<index_t>(pos.y), 0, m_img_lbl.size().y - 1);
         auto const cs = m_img_lbl[{ x, y }] > 0 ? m_cscore.at(m_img_lbl[{ x, y }] - 1) : 0.0f;
 
-        math::Vec2<Float32> mean = p.mean.cast<Float32>();
+        math::Vec2<Float32> mean = pos.cast<Float32>();
         mean.x = (mean.x + 0.5f) / gsl::narrow_cast<Float32>(m_hm.size().x);
         mean.y = (mean.y + 0.5f) / gsl::narrow_cast<Float32>(m_hm.size().y);
 
-        m_touchpoints.push_back(TouchPoint { cs, static_cast<Float32>(p.scale), false, mean, cov->cast<Float32>() });
+        m_touchpoints.push_back(TouchPoint { cs, static_cast<Float32>(m_gf_params.scale[i]), false, mean, cov->cast<Float32>() });
     }
 
     return m_touchpoints;
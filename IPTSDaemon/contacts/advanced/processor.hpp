@@ -2,11 +2,14 @@
 
 #include <common/types.hpp>
 
+#include "algorithm/convolution.hpp"
 #include "algorithm/distance_transform.hpp"
 #include "algorithm/gaussian_fitting.hpp"
 
+#include <container/arena.hpp>
 #include <container/image.hpp>
 #include <container/kernel.hpp>
+#include <container/tensor_image.hpp>
 
 #include <contacts/eval/perf.hpp>
 #include <contacts/interface.hpp>
@@ -15,6 +18,8 @@
 #include <math/mat2.hpp>
 
 #include <array>
+#include <cstddef>
+#include <functional>
 #include <vector>
 #include <queue>
 
@@ -32,27 +37,57 @@ struct ComponentStats {
 };
 
 
+// the most gaussians fitted per heatmap, the strongest maximas are kept if there are more
+inline constexpr std::size_t gfit_max_contacts = 32;
+
+
+struct FitSeed {
+    Float64 scale;
+    Vec2<Float64> mean;
+    Mat2s<Float64> prec;
+    bool used;
+};
+
+
+#ifdef IPTSD_CONFIG_WDT_BINARY_HEAP
+using WdtQueue = std::priority_queue<alg::wdt::QItem<Float32>, std::vector<alg::wdt::QItem<Float32>>,
+                                     std::greater<alg::wdt::QItem<Float32>>>;
+#else
+using WdtQueue = alg::wdt::BucketQueue<Float32>;
+#endif
+
+
 class TouchProcessor : public ITouchProcessor {
 public:
-    TouchProcessor(index2_t size);
+    /*
+     * With approx_math, the filter and the distance transform use the approximations of
+     * math/fast.hpp instead of the standard library.
+     */
+    TouchProcessor(index2_t size, bool approx_math = false);
 
     auto hm() -> Image<Float32> & override;
     auto process() -> std::vector<TouchPoint> const& override;
+    void idle() override;
 
     [[nodiscard]] auto perf() const -> eval::perf::Registry const& override;
+    auto perf() -> eval::perf::Registry& override;
+
+    // scratch memory, for the footprint of the temporary images
+    [[nodiscard]] auto scratch() const -> Arena const&;
 
 private:
+    template<class M>
     auto process(Image<Float32> const& hm) -> std::vector<TouchPoint> const&;
 
     // performance measurements
     eval::perf::Registry m_perf_reg;
     eval::perf::Token m_perf_t_total;
     eval::perf::Token m_perf_t_prep;
+    eval::perf::Token m_perf_t_drv;
     eval::perf::Token m_perf_t_st;
     eval::perf::Token m_perf_t_stev;
     eval::perf::Token m_perf_t_hess;
     eval::perf::Token m_perf_t_rdg;
-    eval::perf::Token m_perf_t_obj;
     eval::perf::Token m_perf_t_lmax;
     eval::perf::Token m_perf_t_lbl;
     eval::perf::Token m_perf_t_cscr;
@@ -60,35 +95,40 @@ private:
     eval::perf::Token m_perf_t_flt;
     eval::perf::Token m_perf_t_lmaxf;
     eval::perf::Token m_perf_t_gfit;
+    eval::perf::Token m_perf_c_gfit_iter;
+
+    // temporary storage, the images are views into the arena
+    Arena m_arena;
 
-    // temporary storage
     Image<Float32> m_hm;
     Image<Float32> m_img_pp;
-    Image<Mat2s<Float32>> m_img_m2_1;
-    Image<Mat2s<Float32>> m_img_m2_2;
-    Image<std::array<Float32, 2>> m_img_stev;
+    TensorImage<Float32> m_img_m2_1;
+    TensorImage<Float32> m_img_m2_2;
+    TensorImage<Float32> m_img_m2_3;
+    Image<Float32> m_img_stg;
+    Image<Float32> m_img_stc;
     Image<Float32> m_img_rdg;
-    Image<Float32> m_img_obj;
     Image<UInt16> m_img_lbl;
-    Image<Float32> m_img_dm1;
-    Image<Float32> m_img_dm2;
+    Image<alg::wdt::Dual<Float32>> m_img_dm;
     Image<Float32> m_img_flt;
     Image<Float64> m_img_gftmp;
 
-    std::priority_queue<alg::wdt::QItem<Float32>> m_wdt_queue;
-    std::vector<alg::gfit::Parameters<Float64>> m_gf_params;
+    WdtQueue m_wdt_queue;
+    alg::gfit::Parameters<Float64, gfit_max_contacts> m_gf_params;
+    alg::gfit::Grid<Float64> m_gf_grid;
+    std::vector<FitSeed> m_gf_prev;
 
     std::vector<index_t> m_maximas;
     std::vector<ComponentStats> m_cstats;
     std::vector<Float32> m_cscore;
 
     // gauss kernels
-    Kernel<Float32, 5, 5> m_kern_pp;
-    Kernel<Float32, 5, 5> m_kern_st;
-    Kernel<Float32, 5, 5> m_kern_hs;
+    alg::conv::Separable<Float32, 5, 5> m_kern_pp;
+    alg::conv::Separable<Float32, 5, 5> m_kern_st;
+    alg::conv::Separable<Float32, 5, 5> m_kern_hs;
 
     // parameters
-    index2_t m_gf_window;
+    bool m_approx_math;
 
     // output
     std::vector<TouchPoint> m_touchpoints;
@@ -100,14 +140,19 @@ inline auto TouchProcessor::perf() const -> eval::perf::Registry const&
     return m_perf_reg;
 }
 
-inline auto TouchProcessor::hm() -> Image<Float32> &
+inline auto TouchProcessor::perf() -> eval::perf::Registry&
 {
-    return m_hm;
+    return m_perf_reg;
+}
+
+inline auto TouchProcessor::scratch() const -> Arena const&
+{
+    return m_arena;
 }
 
-inline auto TouchProcessor::process() -> std::vector<TouchPoint> const&
+inline auto TouchProcessor::hm() -> Image<Float32> &
 {
-	return process(m_hm);
+    return m_hm;
 }
 
 } /* namespace iptsd::contacts::advanced */
@@ -18,7 +18,7 @@ public:
 	Float32 average = 0;
 
 	container::Image<Float32> data;
-	container::Image<bool> visited;
+	container::Image<UInt8> visited;
 
 	Heatmap(index2_t size)
 		: size(size), diagonal(std::sqrt(size.x * size.x + size.y * size.y)), data(size),
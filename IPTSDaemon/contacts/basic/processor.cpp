@@ -16,7 +16,8 @@
 namespace iptsd::contacts::basic {
 
 TouchProcessor::TouchProcessor(Config cfg)
-	: heatmap {cfg.size}, touchpoints {}, cfg {cfg}, perfreg {}
+	: heatmap {cfg.size}, touchpoints {}, cfg {cfg}, perfreg {},
+	  perf_t_total {perfreg.create_entry("total")}
 {
 	touchpoints.reserve(32);
 }
@@ -50,6 +51,8 @@ static bool is_near(const TouchPoint &a, const TouchPoint &b)
 
 const std::vector<TouchPoint> &TouchProcessor::process()
 {
+	auto _t = perfreg.record(perf_t_total);
+
 	heatmap.reset();
 	touchpoints.clear();
 
@@ -18,8 +18,10 @@ public:
 
 	container::Image<Float32> &hm() override;
 	const std::vector<TouchPoint> &process() override;
+	void idle() override;
 
 	[[nodiscard]] const eval::perf::Registry &perf() const override;
+	eval::perf::Registry &perf() override;
 
 private:
 	Heatmap heatmap;
@@ -27,6 +29,7 @@ private:
 
 	Config cfg;
 	eval::perf::Registry perfreg;
+	eval::perf::Token perf_t_total;
 };
 
 inline container::Image<Float32> &TouchProcessor::hm()
@@ -34,11 +37,21 @@ inline container::Image<Float32> &TouchProcessor::hm()
 	return heatmap.data;
 }
 
+inline void TouchProcessor::idle()
+{
+	// every heatmap is processed on its own, there is nothing to forget
+}
+
 inline const eval::perf::Registry &TouchProcessor::perf() const
 {
 	return perfreg;
 }
 
+inline eval::perf::Registry &TouchProcessor::perf()
+{
+	return perfreg;
+}
+
 } /* namespace iptsd::contacts::basic */
 
 #endif /* IPTSD_CONTACTS_BASIC_PROCESSOR_HPP */
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <cmath>
@@ -28,6 +35,35 @@ private:
 };
 
 
+/*
+ * Log-linear histogram of durations in nanoseconds. Values below 2^B are counted exactly,
+ * every power of two above that is split into 2^B linear sub-buckets. This bounds the
+ * relative error of a quantile to 2^-B while using a fixed amount of memory.
+ */
+class Histogram {
+public:
+    static constexpr unsigned sub_bits = 5;
+    static constexpr unsigned max_bits = 40;
+
+    static constexpr std::size_t sub_count = std::size_t{1} << sub_bits;
+    static constexpr std::size_t bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+    void record(std::uint64_t value_ns);
+
+    [[nodiscard]] auto count() const -> std::uint64_t;
+    [[nodiscard]] auto quantile(double q) const -> std::uint64_t;
+
+private:
+    static auto bucket(std::uint64_t value) -> std::size_t;
+    static auto lower(std::size_t bucket) -> std::uint64_t;
+    static auto upper(std::size_t bucket) -> std::uint64_t;
+
+private:
+    std::array<std::uint32_t, bucket_count> m_counts{};
+    std::uint64_t m_total{0};
+};
+
+
 class Entry {
 public:
     Entry(std::string name);
@@ -50,6 +86,9 @@ public:
     template<class D>
     auto stddev() const -> D;
 
+    template<class D>
+    auto percentile(double p) const -> D;
+
 public:
     std::string name;
 
@@ -60,6 +99,96 @@ public:
 
     double r_mean_ns;
     double r_var_ns;
+
+    Histogram histogram;
+};
+
+
+/*
+ * Statistics of a quantity that is not a duration, e.g. the number of iterations of an
+ * algorithm, sampled once per run.
+ */
+class Counter {
+public:
+    Counter(std::string name);
+
+    auto mean() const -> double;
+
+public:
+    std::string name;
+
+    unsigned int n_samples;
+    double sum;
+    double minimum;
+    double maximum;
+};
+
+
+/*
+ * Records every measurement and counter sample of the registries it is attached to (see
+ * Registry::trace()) as an event in the Chrome trace event format, which can be opened in
+ * chrome://tracing or ui.perfetto.dev to look at the nesting and the jitter of the stages.
+ *
+ * The events are kept in memory that is allocated up front for capacity events, and are only
+ * formatted when they are written to a file, so that tracing does not distort the measurements.
+ * An event takes 48 bytes, so the capacity should be derived from the number of frames that
+ * are going to be traced. Events beyond the capacity are counted, but not kept.
+ *
+ * Like a registry, a sink must only be used by one thread at a time, but the events remember
+ * the thread that recorded them.
+ */
+class TraceSink {
+public:
+    explicit TraceSink(std::size_t capacity);
+
+    /*
+     * Sets the frame number attached to the following events.
+     */
+    void frame(std::uint64_t n);
+
+    /*
+     * Writes the events as JSON, with the times in microseconds since the creation of the sink.
+     */
+    void write(std::string const& path) const;
+
+    [[nodiscard]] auto size() const -> std::size_t;
+    [[nodiscard]] auto dropped() const -> std::uint64_t;
+
+private:
+    friend class Registry;
+    friend class measurement;
+
+    struct Name {
+        std::string name;
+        std::string category;
+    };
+
+    struct Event {
+        std::uint32_t name;
+        std::uint32_t thread;
+        std::uint64_t frame;
+        clock::duration start;
+
+        // measurements have a duration, counter samples a value
+        clock::duration duration;
+        double value;
+        bool counter;
+    };
+
+    auto intern(std::string const& name, std::string const& category) -> std::uint32_t;
+
+    void span(std::uint32_t name, clock::time_point start, clock::duration duration);
+    void sample(std::uint32_t name, double value);
+
+    static auto thread() -> std::uint32_t;
+
+private:
+    std::vector<Name> m_names;
+    std::vector<Event> m_events;
+    std::size_t m_capacity;
+    std::uint64_t m_dropped;
+    std::uint64_t m_frame;
+    clock::time_point m_origin;
 };
 
 
@@ -71,11 +200,14 @@ public:
 private:
     friend class Registry;
 
-    measurement(Entry& e, clock::time_point start);
+    measurement(Entry& e, clock::time_point start, TraceSink* sink, std::uint32_t name);
 
 private:
     Entry& m_entry;
     clock::time_point m_start;
+
+    TraceSink* m_sink;
+    std::uint32_t m_name;
 };
 
 
@@ -88,8 +220,30 @@ public:
 
     [[nodiscard]] auto entries() const -> std::vector<Entry> const&;
 
+    // tokens of counters can only be used with count() and get_counter()
+    auto create_counter(std::string name) -> Token;
+
+    void count(Token const& t, double value);
+    [[nodiscard]] auto get_counter(Token const& t) const -> Counter const&;
+
+    [[nodiscard]] auto counters() const -> std::vector<Counter> const&;
+
+    /*
+     * Also records every measurement and counter sample into the given sink, or stops doing
+     * so with nullptr. The events are grouped under the given category.
+     */
+    void trace(TraceSink* sink, std::string category = "perf");
+
 private:
     std::vector<Entry> m_entries;
+    std::vector<Counter> m_counters;
+
+    TraceSink* m_sink = nullptr;
+    std::string m_category;
+
+    // the names of the entries and counters in the sink
+    std::vector<std::uint32_t> m_entry_names;
+    std::vector<std::uint32_t> m_counter_names;
 };
 
 
@@ -98,6 +252,76 @@ inline constexpr Token::Token(std::size_t i)
 {}
 
 
+inline void Histogram::record(std::uint64_t value_ns)
+{
+    m_counts[bucket(value_ns)] += 1;
+    m_total += 1;
+}
+
+inline auto Histogram::count() const -> std::uint64_t
+{
+    return m_total;
+}
+
+/*
+ * Returns the midpoint of the bucket containing the value of rank ceil(q * count), with q
+ * in [0, 1].
+ */
+inline auto Histogram::quantile(double q) const -> std::uint64_t
+{
+    if (m_total == 0)
+        return 0;
+
+    auto const rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * m_total)));
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+        seen += m_counts[i];
+
+        if (seen >= rank)
+            return lower(i) + (upper(i) - lower(i)) / 2;
+    }
+
+    return upper(bucket_count - 1);
+}
+
+inline auto Histogram::bucket(std::uint64_t value) -> std::size_t
+{
+    if (value < sub_count)
+        return static_cast<std::size_t>(value);
+
+    // values above the range are clamped into the last bucket
+    if (value >> max_bits)
+        return bucket_count - 1;
+
+    auto const msb = static_cast<unsigned>(63 - __builtin_clzll(value));
+    auto const sub = static_cast<std::size_t>(value >> (msb - sub_bits)) - sub_count;
+
+    return (msb - sub_bits + 1) * sub_count + sub;
+}
+
+inline auto Histogram::lower(std::size_t bucket) -> std::uint64_t
+{
+    if (bucket < sub_count)
+        return bucket;
+
+    auto const shift = bucket / sub_count - 1;
+    auto const sub = bucket % sub_count;
+
+    return static_cast<std::uint64_t>(sub_count + sub) << shift;
+}
+
+inline auto Histogram::upper(std::size_t bucket) -> std::uint64_t
+{
+    if (bucket < sub_count)
+        return bucket;
+
+    auto const shift = bucket / sub_count - 1;
+
+    return lower(bucket) + (std::uint64_t{1} << shift) - 1;
+}
+
+
 inline Entry::Entry(std::string name)
     : name{std::move(name)}
     , n_measurements{0}
@@ -152,10 +376,157 @@ inline auto Entry::stddev() const -> D
     return std::chrono::duration_cast<D>(std::chrono::nanoseconds(d));
 }
 
+template<class D>
+inline auto Entry::percentile(double p) const -> D
+{
+    if (n_measurements == 0)
+        return D::zero();
+
+    auto const v = histogram.quantile(p / 100.0);
+    auto const d = std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(v));
 
-inline measurement::measurement(Entry& e, clock::time_point start)
+    // the bucket midpoint may lie outside of the range that has actually been observed
+    auto const c = std::clamp(std::chrono::duration_cast<clock::duration>(d), minimum, maximum);
+
+    return std::chrono::duration_cast<D>(c);
+}
+
+
+inline Counter::Counter(std::string name)
+    : name{std::move(name)}
+    , n_samples{0}
+    , sum{0.0}
+    , minimum{0.0}
+    , maximum{0.0}
+{}
+
+inline auto Counter::mean() const -> double
+{
+    return n_samples > 0 ? sum / n_samples : 0.0;
+}
+
+
+inline TraceSink::TraceSink(std::size_t capacity)
+    : m_names{}
+    , m_events{}
+    , m_capacity{capacity}
+    , m_dropped{0}
+    , m_frame{0}
+    , m_origin{clock::now()}
+{
+    m_events.reserve(capacity);
+}
+
+inline void TraceSink::frame(std::uint64_t n)
+{
+    m_frame = n;
+}
+
+inline auto TraceSink::size() const -> std::size_t
+{
+    return m_events.size();
+}
+
+inline auto TraceSink::dropped() const -> std::uint64_t
+{
+    return m_dropped;
+}
+
+inline auto TraceSink::intern(std::string const& name, std::string const& category) -> std::uint32_t
+{
+    for (std::size_t i = 0; i < m_names.size(); ++i) {
+        if (m_names[i].name == name && m_names[i].category == category)
+            return static_cast<std::uint32_t>(i);
+    }
+
+    m_names.push_back(Name { name, category });
+    return static_cast<std::uint32_t>(m_names.size() - 1);
+}
+
+inline auto TraceSink::thread() -> std::uint32_t
+{
+    static std::atomic<std::uint32_t> s_next{1};
+    thread_local std::uint32_t const t_id = s_next.fetch_add(1, std::memory_order_relaxed);
+
+    return t_id;
+}
+
+inline void TraceSink::span(std::uint32_t name, clock::time_point start, clock::duration duration)
+{
+    if (m_events.size() == m_capacity) {
+        m_dropped += 1;
+        return;
+    }
+
+    m_events.push_back(Event { name, thread(), m_frame, start - m_origin, duration, 0.0, false });
+}
+
+inline void TraceSink::sample(std::uint32_t name, double value)
+{
+    if (m_events.size() == m_capacity) {
+        m_dropped += 1;
+        return;
+    }
+
+    auto const now = clock::now() - m_origin;
+    m_events.push_back(Event { name, thread(), m_frame, now, clock::duration{0}, value, true });
+}
+
+inline void TraceSink::write(std::string const& path) const
+{
+    using us = std::chrono::duration<double, std::micro>;
+
+    auto const escape = [](std::string const& str) {
+        std::string out;
+
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+
+            out += c;
+        }
+
+        return out;
+    };
+
+    std::ofstream file{path};
+    if (!file)
+        throw std::runtime_error("Failed to open " + path);
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+
+    for (std::size_t i = 0; i < m_events.size(); ++i) {
+        auto const& e = m_events[i];
+        auto const& n = m_names[e.name];
+
+        file << "{\"name\":\"" << escape(n.name) << "\",\"cat\":\"" << escape(n.category)
+             << "\"";
+        file << ",\"ts\":" << us(e.start).count() << ",\"pid\":1,\"tid\":" << e.thread;
+
+        // counters are shown per process, the name alone has to tell them apart
+        if (e.counter)
+            file << ",\"ph\":\"C\",\"args\":{\"value\":" << e.value << "}}";
+        else
+            file << ",\"ph\":\"X\",\"dur\":" << us(e.duration).count()
+                 << ",\"args\":{\"frame\":" << e.frame << "}}";
+
+        file << (i + 1 < m_events.size() ? ",\n" : "\n");
+    }
+
+    file << "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << m_dropped << "}}\n";
+
+    if (!file)
+        throw std::runtime_error("Failed to write " + path);
+}
+
+
+inline measurement::measurement(Entry& e, clock::time_point start, TraceSink* sink,
+                                std::uint32_t name)
     : m_entry{e}
     , m_start{start}
+    , m_sink{sink}
+    , m_name{name}
 {}
 
 inline measurement::~measurement()
@@ -191,19 +562,29 @@ inline void measurement::stop()
     m_entry.r_mean_ns = r_mean_new;
     m_entry.r_var_ns = r_var_new;
 
+    m_entry.histogram.record(static_cast<std::uint64_t>(d_ns));
+
+    if (m_sink)
+        m_sink->span(m_name, m_start, duration);
+
     m_start = clock::time_point::max();
 }
 
 
 inline auto Registry::create_entry(std::string name) -> Token
 {
+    if (m_sink)
+        m_entry_names.push_back(m_sink->intern(name, m_category));
+
     m_entries.emplace_back(std::move(name));
     return Token { m_entries.size() - 1 };
 }
 
 inline auto Registry::record(Token const& t) -> measurement
 {
-    return measurement { m_entries[t.m_index], clock::now() };
+    auto const name = m_sink ? m_entry_names[t.m_index] : 0;
+
+    return measurement { m_entries[t.m_index], clock::now(), m_sink, name };
 }
 
 inline auto Registry::get_entry(Token const& t) const -> Entry const&
@@ -216,4 +597,54 @@ inline auto Registry::entries() const -> std::vector<Entry> const&
     return m_entries;
 }
 
+inline auto Registry::create_counter(std::string name) -> Token
+{
+    if (m_sink)
+        m_counter_names.push_back(m_sink->intern(name, m_category));
+
+    m_counters.emplace_back(std::move(name));
+    return Token { m_counters.size() - 1 };
+}
+
+inline void Registry::count(Token const& t, double value)
+{
+    auto& c = m_counters[t.m_index];
+
+    c.minimum = c.n_samples > 0 ? std::min(c.minimum, value) : value;
+    c.maximum = c.n_samples > 0 ? std::max(c.maximum, value) : value;
+    c.n_samples += 1;
+    c.sum += value;
+
+    if (m_sink)
+        m_sink->sample(m_counter_names[t.m_index], value);
+}
+
+inline auto Registry::get_counter(Token const& t) const -> Counter const&
+{
+    return m_counters[t.m_index];
+}
+
+inline auto Registry::counters() const -> std::vector<Counter> const&
+{
+    return m_counters;
+}
+
+inline void Registry::trace(TraceSink* sink, std::string category)
+{
+    m_sink = sink;
+    m_category = std::move(category);
+
+    m_entry_names.clear();
+    m_counter_names.clear();
+
+    if (!sink)
+        return;
+
+    for (auto const& e : m_entries)
+        m_entry_names.push_back(sink->intern(e.name, m_category));
+
+    for (auto const& c : m_counters)
+        m_counter_names.push_back(sink->intern(c.name, m_category));
+}
+
 } /* namespace iptsd::contacts::advanced::eval::perf */
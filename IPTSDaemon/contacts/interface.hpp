@@ -34,7 +34,14 @@ public:
 	virtual container::Image<Float32> &hm() = 0;
 	virtual const std::vector<TouchPoint> &process() = 0;
 
+	/*
+	 * Called instead of process() for a heatmap that is known to have no contacts, so that
+	 * nothing the processor remembers from earlier frames carries over the idle gap.
+	 */
+	virtual void idle() = 0;
+
 	[[nodiscard]] virtual const eval::perf::Registry &perf() const = 0;
+	virtual eval::perf::Registry &perf() = 0;
 };
 
 } /* namespace iptsd::contacts */
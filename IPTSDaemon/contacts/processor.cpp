@@ -18,11 +18,21 @@ const std::vector<TouchPoint> &TouchProcessor::process()
 	return tp->process();
 }
 
+void TouchProcessor::idle()
+{
+	tp->idle();
+}
+
 const eval::perf::Registry &TouchProcessor::perf() const
 {
 	return tp->perf();
 }
 
+eval::perf::Registry &TouchProcessor::perf()
+{
+	return tp->perf();
+}
+
 void TouchProcessor::resize(index2_t size)
 {
 	if (tp) {
@@ -37,9 +47,12 @@ void TouchProcessor::resize(index2_t size)
 	if (!advanced) {
 		tp = std::make_unique<basic::TouchProcessor>(conf);
 	} else {
-		tp = std::make_unique<advanced::TouchProcessor>(conf.size);
+		tp = std::make_unique<advanced::TouchProcessor>(conf.size, approx_math);
 	}
 
+	if (trace)
+		tp->perf().trace(trace, advanced ? "advanced" : "basic");
+
 	diag = gsl::narrow_cast<UInt16>(std::sqrt(size.x * size.x + size.y * size.y));
 }
 
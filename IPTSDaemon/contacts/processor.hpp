@@ -17,8 +17,10 @@ class TouchProcessor : public ITouchProcessor {
 public:
 	container::Image<Float32> &hm() override;
 	const std::vector<TouchPoint> &process() override;
+	void idle() override;
 
 	[[nodiscard]] const eval::perf::Registry &perf() const override;
+	eval::perf::Registry &perf() override;
 
 	UInt16 diagonal();
 	void resize(index2_t size);
@@ -26,6 +28,12 @@ public:
 	Config conf;
 	bool advanced = false;
 
+	// Use the approximations of math/fast.hpp in the advanced processor
+	bool approx_math = false;
+
+	// Attached to the registry of every processor that is created, see eval::perf::TraceSink
+	eval::perf::TraceSink *trace = nullptr;
+
 private:
 	UInt16 diag = 0;
 	std::unique_ptr<ITouchProcessor> tp;
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTAINER_ARENA_HPP
+#define IPTSD_CONTAINER_ARENA_HPP
+
+#include "image.hpp"
+
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace iptsd::container {
+
+/*
+ * A single contiguous block of scratch memory for buffers with known sizes and lifetimes.
+ *
+ * Buffers are first reserved together with the first and last stage in which they are used.
+ * allocate() then places them in the block, so that buffers of the same type whose lifetimes
+ * do not overlap share memory. Buffers of different types never share, so that the compiler
+ * can keep assuming that pointers to different types do not alias. Every buffer starts at a
+ * multiple of the alignment. The memory is zeroed on allocation and never reallocated.
+ */
+class Arena {
+public:
+	static constexpr std::size_t alignment = 64;
+
+	using slot = std::size_t;
+
+public:
+	template <class T> auto reserve(index_t count, index_t first, index_t last) -> slot;
+
+	void allocate();
+
+	template <class T> auto get(slot s) -> T *;
+	template <class T> auto image(slot s, index2_t size) -> Image<T>;
+
+	/*
+	 * The size of the block in bytes, i.e. the footprint of all buffers.
+	 */
+	[[nodiscard]] auto size() const -> std::size_t;
+
+	/*
+	 * The sum of the sizes of all buffers in bytes, i.e. the footprint without any sharing.
+	 */
+	[[nodiscard]] auto requested() const -> std::size_t;
+
+private:
+	struct Entry {
+		void const *type;
+		std::size_t bytes;
+		index_t first;
+		index_t last;
+		std::size_t offset;
+	};
+
+	template <class T> static inline char const type_tag = 0;
+
+	static constexpr auto align(std::size_t n) -> std::size_t;
+
+	std::vector<Entry> m_entries;
+	std::vector<std::byte> m_buffer;
+	std::byte *m_data = nullptr;
+	std::size_t m_size = 0;
+};
+
+template <class T> auto Arena::reserve(index_t count, index_t first, index_t last) -> slot
+{
+	static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+	static_assert(alignof(T) <= alignment);
+
+	if (m_data)
+		throw std::logic_error("Arena: reserve() after allocate()");
+
+	auto const bytes = static_cast<std::size_t>(count) * sizeof(T);
+	m_entries.push_back(Entry {&type_tag<T>, bytes, first, last, 0});
+
+	return m_entries.size() - 1;
+}
+
+inline void Arena::allocate()
+{
+	std::vector<Entry *> order(m_entries.size());
+	std::transform(m_entries.begin(), m_entries.end(), order.begin(),
+		       [](Entry &e) { return &e; });
+
+	// placing the buffers by first use makes equally sized buffers pack optimally
+	std::stable_sort(order.begin(), order.end(), [](Entry const *a, Entry const *b) {
+		return a->first < b->first || (a->first == b->first && a->bytes > b->bytes);
+	});
+
+	std::vector<Entry const *> placed;
+	std::vector<Entry const *> conflicts;
+	m_size = 0;
+
+	for (Entry *e : order) {
+		conflicts.clear();
+
+		for (Entry const *p : placed) {
+			bool const overlap = e->first <= p->last && p->first <= e->last;
+
+			if (overlap || e->type != p->type)
+				conflicts.push_back(p);
+		}
+
+		std::sort(conflicts.begin(), conflicts.end(), [](Entry const *a, Entry const *b) {
+			return a->offset < b->offset;
+		});
+
+		// first gap between the conflicting buffers that is large enough
+		std::size_t offset = 0;
+		for (Entry const *c : conflicts) {
+			if (offset + e->bytes <= c->offset)
+				break;
+
+			offset = std::max(offset, align(c->offset + c->bytes));
+		}
+
+		e->offset = offset;
+		m_size = std::max(m_size, align(offset + e->bytes));
+
+		placed.push_back(e);
+	}
+
+	// zero-initialized, the same as a freshly created image
+	m_buffer.assign(m_size + alignment - 1, std::byte {0});
+
+	void *ptr = m_buffer.data();
+	std::size_t space = m_buffer.size();
+	m_data = static_cast<std::byte *>(std::align(alignment, m_size, ptr, space));
+}
+
+template <class T> inline auto Arena::get(slot s) -> T *
+{
+	auto const &e = m_entries.at(s);
+
+	if (!m_data || e.type != &type_tag<T>)
+		throw std::logic_error("Arena: invalid access");
+
+	return reinterpret_cast<T *>(m_data + e.offset);
+}
+
+template <class T> inline auto Arena::image(slot s, index2_t size) -> Image<T>
+{
+	if (static_cast<std::size_t>(size.span()) * sizeof(T) > m_entries.at(s).bytes)
+		throw std::logic_error("Arena: image exceeds slot");
+
+	return Image<T> {size, get<T>(s)};
+}
+
+inline auto Arena::size() const -> std::size_t
+{
+	return m_size;
+}
+
+inline auto Arena::requested() const -> std::size_t
+{
+	std::size_t n = 0;
+
+	for (auto const &e : m_entries)
+		n += align(e.bytes);
+
+	return n;
+}
+
+inline constexpr auto Arena::align(std::size_t n) -> std::size_t
+{
+	return (n + alignment - 1) / alignment * alignment;
+}
+
+} /* namespace iptsd::container */
+
+#endif /* IPTSD_CONTAINER_ARENA_HPP */
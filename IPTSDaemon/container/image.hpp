@@ -3,23 +3,52 @@
 #ifndef IPTSD_CONTAINER_IMAGE_HPP
 #define IPTSD_CONTAINER_IMAGE_HPP
 
+#include "image_view.hpp"
+
 #include <common/access.hpp>
 #include <common/types.hpp>
 
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <memory>
+#include <numeric>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
 namespace iptsd::container {
 
+/*
+ * Memory layout of an owning image. With the default layout the pixels are stored densely,
+ * i.e. stride() == size().x. Otherwise every row starts at a multiple of alignment bytes, and
+ * the pixels are surrounded by guard.x columns and guard.y rows of zeros on each side. The
+ * guard pixels can be accessed with coordinates outside of the image, e.g. by kernels that
+ * would otherwise have to handle the border separately.
+ *
+ * The pixels are stored in a std::vector, so an alignment larger than alignof(T) has to be a
+ * multiple of sizeof(T), otherwise the first row would start inside a pixel.
+ */
+struct Layout {
+	std::size_t alignment = 0;
+	index2_t guard {0, 0};
+};
+
+/*
+ * A row-major image. By default the image owns its pixels. An image constructed from a pointer
+ * is a view of memory owned by someone else (e.g. an Arena), which has to outlive it. Copying
+ * an owning image copies the pixels, copying a view creates another view of the same memory.
+ *
+ * Linear indices count rows in units of stride(), so i = y * stride() + x. The iterators
+ * and the static ravel() / unravel() assume a contiguous image, i.e. the default layout.
+ */
 template <class T> class Image {
 public:
 	using array_type = std::vector<T>;
-	using iterator = typename array_type::iterator;
-	using const_iterator = typename array_type::const_iterator;
-	using reverse_iterator = typename array_type::reverse_iterator;
-	using const_reverse_iterator = typename array_type::const_reverse_iterator;
+	using iterator = T *;
+	using const_iterator = T const *;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
 	using value_type = typename array_type::value_type;
 	using reference = typename array_type::reference;
@@ -30,13 +59,32 @@ public:
 public:
 	Image();
 	Image(index2_t size);
+	Image(index2_t size, Layout layout);
+	Image(index2_t size, pointer data);
+
+	Image(Image const &other);
+	Image(Image &&other) noexcept;
+
+	auto operator=(Image const &other) -> Image &;
+	auto operator=(Image &&other) noexcept -> Image &;
 
 	[[nodiscard]] auto size() const -> index2_t;
 	[[nodiscard]] auto stride() const -> index_t;
+	[[nodiscard]] auto layout() const -> Layout;
+	[[nodiscard]] auto is_view() const -> bool;
+	[[nodiscard]] auto is_contiguous() const -> bool;
 
 	auto data() -> pointer;
 	[[nodiscard]] auto data() const -> const_pointer;
 
+	auto row(index_t y) -> pointer;
+	[[nodiscard]] auto row(index_t y) const -> const_pointer;
+
+	auto view() -> ImageView<T>;
+	[[nodiscard]] auto view() const -> ImageView<T const>;
+
+	[[nodiscard]] auto offset(index2_t const &i) const -> index_t;
+
 	auto operator[](index2_t const &i) const -> const_reference;
 	auto operator[](index2_t const &i) -> reference;
 
@@ -56,16 +104,128 @@ public:
 	static constexpr auto unravel(index2_t size, index_t i) -> index2_t;
 
 private:
+	void allocate();
+	[[nodiscard]] auto storage() const -> index_t;
+
 	index2_t m_size;
+	index_t m_stride;
+	index_t m_offset;
+	Layout m_layout;
 	array_type m_data {};
+	pointer m_ptr;
 };
 
-template <class T> Image<T>::Image() : m_size {0, 0}
+template <class T>
+Image<T>::Image() : m_size {0, 0}, m_stride {0}, m_offset {0}, m_layout {}, m_ptr {nullptr}
 {}
 
-template <class T> Image<T>::Image(index2_t size) : m_size {size}, m_data(size.span())
+template <class T> Image<T>::Image(index2_t size) : Image(size, Layout {})
 {}
 
+template <class T>
+Image<T>::Image(index2_t size, Layout layout)
+	: m_size {size}, m_stride {0}, m_offset {0}, m_layout {layout}, m_ptr {nullptr}
+{
+	allocate();
+}
+
+template <class T>
+Image<T>::Image(index2_t size, pointer data)
+	: m_size {size}, m_stride {size.x}, m_offset {0}, m_layout {}, m_ptr {data}
+{}
+
+template <class T>
+Image<T>::Image(Image const &other)
+	: m_size {other.m_size}, m_stride {other.m_stride}, m_offset {other.m_offset},
+	  m_layout {other.m_layout}, m_ptr {other.m_ptr}
+{
+	if (other.is_view())
+		return;
+
+	// the copy may be aligned differently, so lay it out from scratch
+	allocate();
+	std::copy_n(other.m_ptr - other.m_offset, storage(), m_ptr - m_offset);
+}
+
+template <class T>
+Image<T>::Image(Image &&other) noexcept
+	: m_size {other.m_size}, m_stride {other.m_stride}, m_offset {other.m_offset},
+	  m_layout {other.m_layout}, m_data(std::move(other.m_data)), m_ptr {other.m_ptr}
+{
+	other = Image {};
+}
+
+template <class T> auto Image<T>::operator=(Image const &other) -> Image &
+{
+	if (this != &other)
+		*this = Image {other};
+
+	return *this;
+}
+
+template <class T> auto Image<T>::operator=(Image &&other) noexcept -> Image &
+{
+	if (this != &other) {
+		m_size = other.m_size;
+		m_stride = other.m_stride;
+		m_offset = other.m_offset;
+		m_layout = other.m_layout;
+		m_data = std::move(other.m_data);
+		m_ptr = other.m_ptr;
+
+		other.m_size = {0, 0};
+		other.m_stride = 0;
+		other.m_offset = 0;
+		other.m_layout = {};
+		other.m_data.clear();
+		other.m_ptr = nullptr;
+	}
+
+	return *this;
+}
+
+template <class T> void Image<T>::allocate()
+{
+	auto const guard = m_layout.guard;
+
+	if (m_layout.alignment == 0 && guard.x == 0 && guard.y == 0) {
+		m_stride = m_size.x;
+		m_offset = 0;
+		m_data.assign(m_size.span(), T {});
+		m_ptr = m_data.data();
+		return;
+	}
+
+	if (m_layout.alignment > alignof(T) && m_layout.alignment % sizeof(T) != 0)
+		throw std::invalid_argument("Image: alignment is not a multiple of the pixel size");
+
+	// rows start at multiples of the alignment if the stride is a multiple of a pixels
+	auto const align = std::max(m_layout.alignment, alignof(T));
+	auto const a = static_cast<index_t>(align / std::gcd(align, sizeof(T)));
+
+	auto const round = [&](index_t n) { return (n + a - 1) / a * a; };
+
+	auto const lead = round(guard.x);
+
+	m_stride = round(lead + m_size.x + guard.x);
+	m_offset = guard.y * m_stride + lead;
+
+	// the vector itself is only aligned for T, leave room to align the first row
+	auto const slack = static_cast<index_t>((align + sizeof(T) - 1) / sizeof(T));
+	m_data.assign(storage() + slack, T {});
+
+	void *base = m_data.data();
+	auto space = m_data.size() * sizeof(T);
+	base = std::align(align, storage() * sizeof(T), base, space);
+
+	m_ptr = static_cast<pointer>(base) + m_offset;
+}
+
+template <class T> inline auto Image<T>::storage() const -> index_t
+{
+	return (m_size.y + 2 * m_layout.guard.y) * m_stride;
+}
+
 template <class T> inline auto Image<T>::size() const -> index2_t
 {
 	return m_size;
@@ -73,67 +233,107 @@ template <class T> inline auto Image<T>::size() const -> index2_t
 
 template <class T> inline auto Image<T>::stride() const -> index_t
 {
-	return m_size.x;
+	return m_stride;
+}
+
+template <class T> inline auto Image<T>::layout() const -> Layout
+{
+	return m_layout;
+}
+
+template <class T> inline auto Image<T>::is_view() const -> bool
+{
+	return m_data.empty() && m_ptr != nullptr;
+}
+
+template <class T> inline auto Image<T>::is_contiguous() const -> bool
+{
+	return m_stride == m_size.x || m_size.y <= 1;
 }
 
 template <class T> inline auto Image<T>::data() -> pointer
 {
-	return m_data.data();
+	return m_ptr;
 }
 
 template <class T> inline auto Image<T>::data() const -> const_pointer
 {
-	return m_data.data();
+	return m_ptr;
+}
+
+template <class T> inline auto Image<T>::row(index_t y) -> pointer
+{
+	return m_ptr + y * m_stride;
+}
+
+template <class T> inline auto Image<T>::row(index_t y) const -> const_pointer
+{
+	return m_ptr + y * m_stride;
+}
+
+template <class T> inline auto Image<T>::view() -> ImageView<T>
+{
+	return ImageView<T> {m_size, m_stride, m_ptr};
+}
+
+template <class T> inline auto Image<T>::view() const -> ImageView<T const>
+{
+	return ImageView<T const> {m_size, m_stride, m_ptr};
+}
+
+template <class T> inline auto Image<T>::offset(index2_t const &i) const -> index_t
+{
+	return i.y * m_stride + i.x;
 }
 
 template <class T> inline auto Image<T>::operator[](index2_t const &i) const -> const_reference
 {
-	return m_data[ravel(m_size, i)];
+	return m_ptr[offset(i)];
 }
 
 template <class T> inline auto Image<T>::operator[](index2_t const &i) -> reference
 {
-	return m_data[ravel(m_size, i)];
+	return m_ptr[offset(i)];
 }
 
 template <class T> inline auto Image<T>::operator[](index_t const &i) const -> const_reference
 {
-	return m_data[i];
+	return m_ptr[i];
 }
 
 template <class T> inline auto Image<T>::operator[](index_t const &i) -> reference
 {
-	return m_data[i];
+	return m_ptr[i];
 }
 
 template <class T> inline auto Image<T>::begin() -> iterator
 {
-	return m_data.begin();
+	return m_ptr;
 }
 
 template <class T> inline auto Image<T>::end() -> iterator
 {
-	return m_data.end();
+	return m_ptr + m_size.span();
 }
 
 template <class T> inline auto Image<T>::begin() const -> const_iterator
 {
-	return m_data.cbegin();
+	return m_ptr;
 }
 
 template <class T> inline auto Image<T>::end() const -> const_iterator
 {
-	return m_data.cend();
+	return m_ptr + m_size.span();
 }
 
 template <class T> inline auto Image<T>::cbegin() const -> const_iterator
 {
-	return m_data.cbegin();
+	return m_ptr;
 }
 
 template <class T> inline auto Image<T>::cend() const -> const_iterator
 {
-	return m_data.cend();
+	return m_ptr + m_size.span();
 }
 
 template <class T> inline constexpr auto Image<T>::ravel(index2_t size, index2_t i) -> index_t
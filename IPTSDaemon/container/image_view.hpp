@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTAINER_IMAGE_VIEW_HPP
+#define IPTSD_CONTAINER_IMAGE_VIEW_HPP
+
+#include <common/types.hpp>
+
+#include <type_traits>
+
+namespace iptsd::container {
+
+/*
+ * A non-owning view of a rectangular region of an image. Rows are stride() pixels apart, so
+ * a view can refer to a region of interest of a larger image. Use ImageView<T const> for
+ * read-only access. The viewed memory has to outlive the view.
+ */
+template <class T> class ImageView {
+public:
+	using value_type = std::remove_const_t<T>;
+	using reference = T &;
+	using pointer = T *;
+
+public:
+	ImageView();
+	ImageView(index2_t size, index_t stride, pointer data);
+
+	operator ImageView<T const>() const;
+
+	[[nodiscard]] auto size() const -> index2_t;
+	[[nodiscard]] auto stride() const -> index_t;
+	[[nodiscard]] auto is_contiguous() const -> bool;
+
+	[[nodiscard]] auto data() const -> pointer;
+	[[nodiscard]] auto row(index_t y) const -> pointer;
+
+	auto operator[](index2_t const &i) const -> reference;
+	auto operator[](index_t const &i) const -> reference;
+
+	/*
+	 * The region of the given size starting at pos. The region may extend into the guard
+	 * pixels of a padded image, but not beyond.
+	 */
+	[[nodiscard]] auto roi(index2_t pos, index2_t size) const -> ImageView;
+
+private:
+	index2_t m_size;
+	index_t m_stride;
+	pointer m_data;
+};
+
+template <class T> ImageView<T>::ImageView() : m_size {0, 0}, m_stride {0}, m_data {nullptr}
+{}
+
+template <class T>
+ImageView<T>::ImageView(index2_t size, index_t stride, pointer data)
+	: m_size {size}, m_stride {stride}, m_data {data}
+{}
+
+template <class T> inline ImageView<T>::operator ImageView<T const>() const
+{
+	return ImageView<T const> {m_size, m_stride, m_data};
+}
+
+template <class T> inline auto ImageView<T>::size() const -> index2_t
+{
+	return m_size;
+}
+
+template <class T> inline auto ImageView<T>::stride() const -> index_t
+{
+	return m_stride;
+}
+
+template <class T> inline auto ImageView<T>::is_contiguous() const -> bool
+{
+	return m_stride == m_size.x || m_size.y <= 1;
+}
+
+template <class T> inline auto ImageView<T>::data() const -> pointer
+{
+	return m_data;
+}
+
+template <class T> inline auto ImageView<T>::row(index_t y) const -> pointer
+{
+	return m_data + y * m_stride;
+}
+
+template <class T> inline auto ImageView<T>::operator[](index2_t const &i) const -> reference
+{
+	return m_data[i.y * m_stride + i.x];
+}
+
+template <class T> inline auto ImageView<T>::operator[](index_t const &i) const -> reference
+{
+	return m_data[i];
+}
+
+template <class T>
+inline auto ImageView<T>::roi(index2_t pos, index2_t size) const -> ImageView
+{
+	return ImageView {size, m_stride, m_data + pos.y * m_stride + pos.x};
+}
+
+} /* namespace iptsd::container */
+
+#endif /* IPTSD_CONTAINER_IMAGE_VIEW_HPP */
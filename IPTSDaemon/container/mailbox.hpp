@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTAINER_MAILBOX_HPP
+#define IPTSD_CONTAINER_MAILBOX_HPP
+
+#include <common/types.hpp>
+
+#include <array>
+#include <atomic>
+
+namespace iptsd::container {
+
+/*
+ * A single value passed from one producer thread to one consumer thread, where a new value
+ * replaces one that has not been taken yet ("latest wins").
+ *
+ * This is a triple buffer: the producer writes into a slot of its own and swaps it with the
+ * shared slot to publish it, the consumer swaps its own slot with the shared one to take the
+ * newest value. Neither side ever waits for the other, and values are never copied between
+ * slots. Since the slots are reused, values that own memory (e.g. a std::vector) stop
+ * allocating once they have reached their largest size.
+ */
+template <class T> class Mailbox {
+public:
+	/*
+	 * Producer only. The slot the next value is written into.
+	 */
+	T &slot();
+
+	/*
+	 * Producer only. Publishes the value written into slot(). Returns true if that replaced
+	 * a value that was never taken.
+	 */
+	bool publish();
+
+	/*
+	 * Consumer only. Returns the newest value if one has been published since the last call,
+	 * and nullptr otherwise. The value stays valid until the next call.
+	 */
+	T *take();
+
+	/*
+	 * Whether a value is waiting to be taken.
+	 */
+	[[nodiscard]] bool ready() const;
+
+	[[nodiscard]] UInt64 published() const;
+
+	/*
+	 * The number of values that were replaced before they were taken.
+	 */
+	[[nodiscard]] UInt64 dropped() const;
+
+private:
+	static constexpr UInt8 index = 3;
+	static constexpr UInt8 fresh = 4;
+
+	std::array<T, 3> slots {};
+
+	// the index of the shared slot, and whether it holds a value that was not taken yet
+	std::atomic<UInt8> shared {1};
+
+	UInt8 back = 0;
+	UInt8 front = 2;
+
+	std::atomic<UInt64> n_published {0};
+	std::atomic<UInt64> n_dropped {0};
+};
+
+template <class T> inline T &Mailbox<T>::slot()
+{
+	return slots[back];
+}
+
+template <class T> inline bool Mailbox<T>::publish()
+{
+	const UInt8 prev = shared.exchange(back | fresh, std::memory_order_acq_rel);
+	back = prev & index;
+
+	n_published.store(n_published.load(std::memory_order_relaxed) + 1,
+			  std::memory_order_relaxed);
+
+	if (!(prev & fresh))
+		return false;
+
+	n_dropped.store(n_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return true;
+}
+
+template <class T> inline T *Mailbox<T>::take()
+{
+	if (!ready())
+		return nullptr;
+
+	const UInt8 prev = shared.exchange(front, std::memory_order_acq_rel);
+	front = prev & index;
+
+	return &slots[front];
+}
+
+template <class T> inline bool Mailbox<T>::ready() const
+{
+	return shared.load(std::memory_order_acquire) & fresh;
+}
+
+template <class T> inline UInt64 Mailbox<T>::published() const
+{
+	return n_published.load(std::memory_order_relaxed);
+}
+
+template <class T> inline UInt64 Mailbox<T>::dropped() const
+{
+	return n_dropped.load(std::memory_order_relaxed);
+}
+
+} /* namespace iptsd::container */
+
+#endif /* IPTSD_CONTAINER_MAILBOX_HPP */
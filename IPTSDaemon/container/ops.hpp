@@ -3,11 +3,15 @@
 #ifndef IPTSD_CONTAINER_OPS_HPP
 #define IPTSD_CONTAINER_OPS_HPP
 
+#include <common/types.hpp>
 #include <math/num.hpp>
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <numeric>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 namespace iptsd::container::ops {
@@ -44,11 +48,287 @@ template <class C, class F> inline void transform(C &container, F fn)
 	std::transform(container.begin(), container.end(), container.begin(), fn);
 }
 
-template <class C> inline auto sum(C const &container) -> typename C::value_type
+/*
+ * Lazy element-wise expressions over images.
+ *
+ * An expression is only a description of how to compute each pixel. Nothing is computed until
+ * it is assigned to an image or reduced, which then happens in a single loop over all pixels,
+ * no matter how many operations the expression consists of. Images enter an expression via
+ * ref(), scalars are broadcast to all pixels. Expressions can also be passed directly to
+ * algorithms that read pixels by linear index, instead of storing them in an image first.
+ *
+ * Like for an image, linear indices count rows in units of stride(), which is the stride of
+ * the images in the expression. All images in an expression must have the same size and the
+ * same stride, but they may be padded.
+ */
+namespace impl {
+
+template <class E> struct is_expr : std::false_type {};
+
+template <class E> inline constexpr bool is_expr_v = is_expr<std::decay_t<E>>::value;
+
+template <class A, class B>
+inline constexpr bool is_operand_v =
+	(is_expr_v<A> || is_expr_v<B>) && (is_expr_v<A> || std::is_arithmetic_v<std::decay_t<A>>) &&
+	(is_expr_v<B> || std::is_arithmetic_v<std::decay_t<B>>);
+
+} /* namespace impl */
+
+/*
+ * An image as a leaf of an expression. Only holds a reference, the image has to outlive the
+ * expression.
+ */
+template <class C> class Ref {
+public:
+	using value_type = typename C::value_type;
+
+public:
+	explicit Ref(C const &container) : m_container {&container}
+	{}
+
+	[[nodiscard]] auto size() const -> index2_t
+	{
+		return m_container->size();
+	}
+
+	[[nodiscard]] auto stride() const -> index_t
+	{
+		return m_container->stride();
+	}
+
+	auto operator[](index_t i) const -> value_type
+	{
+		return (*m_container)[i];
+	}
+
+private:
+	C const *m_container;
+};
+
+/*
+ * A scalar broadcast to all pixels.
+ */
+template <class T> class Scalar {
+public:
+	using value_type = T;
+
+public:
+	explicit Scalar(T value) : m_value {value}
+	{}
+
+	auto operator[](index_t /* i */) const -> value_type
+	{
+		return m_value;
+	}
+
+private:
+	T m_value;
+};
+
+/*
+ * The function F applied to the pixels of the expressions E at the same index.
+ */
+template <class F, class... E> class Map {
+public:
+	using value_type = std::decay_t<std::invoke_result_t<F, typename E::value_type...>>;
+
+public:
+	Map(F fn, E... args) : m_fn {std::move(fn)}, m_args {std::move(args)...}
+	{
+		assert(std::apply([&](auto const &...a) { return (matches(a) && ...); }, m_args));
+	}
+
+	[[nodiscard]] auto size() const -> index2_t
+	{
+		return std::apply([](auto const &...a) { return size_of(a...); }, m_args);
+	}
+
+	[[nodiscard]] auto stride() const -> index_t
+	{
+		return std::apply([](auto const &...a) { return stride_of(a...); }, m_args);
+	}
+
+	auto operator[](index_t i) const -> value_type
+	{
+		return std::apply([&](auto const &...a) { return m_fn(a[i]...); }, m_args);
+	}
+
+private:
+	// the size and the stride of the first argument that is not a scalar
+	template <class A, class... R> static auto size_of(A const &a, R const &...r) -> index2_t
+	{
+		if constexpr (std::is_same_v<A, Scalar<typename A::value_type>>)
+			return size_of(r...);
+		else
+			return a.size();
+	}
+
+	template <class A, class... R> static auto stride_of(A const &a, R const &...r) -> index_t
+	{
+		if constexpr (std::is_same_v<A, Scalar<typename A::value_type>>)
+			return stride_of(r...);
+		else
+			return a.stride();
+	}
+
+	template <class A> auto matches(A const &a) const -> bool
+	{
+		if constexpr (std::is_same_v<A, Scalar<typename A::value_type>>)
+			return true;
+		else
+			return a.size() == size() && a.stride() == stride();
+	}
+
+	F m_fn;
+	std::tuple<E...> m_args;
+};
+
+namespace impl {
+
+template <class C> struct is_expr<Ref<C>> : std::true_type {};
+template <class T> struct is_expr<Scalar<T>> : std::true_type {};
+template <class F, class... E> struct is_expr<Map<F, E...>> : std::true_type {};
+
+template <class C, class = void> struct has_stride : std::false_type {};
+
+template <class C>
+struct has_stride<C, std::void_t<decltype(std::declval<C const &>().stride())>> : std::true_type {};
+
+template <class C> inline constexpr bool has_stride_v = has_stride<C>::value;
+
+template <class A> inline auto operand(A &&a)
+{
+	if constexpr (is_expr_v<A>)
+		return std::forward<A>(a);
+	else
+		return Scalar<std::decay_t<A>> {a};
+}
+
+} /* namespace impl */
+
+template <class C> inline auto ref(C const &container) -> Ref<C>
+{
+	return Ref<C> {container};
+}
+
+template <class F, class... E> inline auto map(F fn, E &&...args)
+{
+	return Map {std::move(fn), impl::operand(std::forward<E>(args))...};
+}
+
+template <class A, class B, std::enable_if_t<impl::is_operand_v<A, B>, int> = 0>
+inline auto operator+(A &&a, B &&b)
+{
+	return map(std::plus<> {}, std::forward<A>(a), std::forward<B>(b));
+}
+
+template <class A, class B, std::enable_if_t<impl::is_operand_v<A, B>, int> = 0>
+inline auto operator-(A &&a, B &&b)
+{
+	return map(std::minus<> {}, std::forward<A>(a), std::forward<B>(b));
+}
+
+template <class A, class B, std::enable_if_t<impl::is_operand_v<A, B>, int> = 0>
+inline auto operator*(A &&a, B &&b)
+{
+	return map(std::multiplies<> {}, std::forward<A>(a), std::forward<B>(b));
+}
+
+template <class A, class B, std::enable_if_t<impl::is_operand_v<A, B>, int> = 0>
+inline auto operator/(A &&a, B &&b)
+{
+	return map(std::divides<> {}, std::forward<A>(a), std::forward<B>(b));
+}
+
+template <class A, std::enable_if_t<impl::is_expr_v<A>, int> = 0> inline auto operator-(A &&a)
+{
+	return map(std::negate<> {}, std::forward<A>(a));
+}
+
+/*
+ * Element-wise std::min() and std::max(), e.g. max(x, 0.0f) to clamp negative values.
+ */
+template <class A, class B, std::enable_if_t<impl::is_operand_v<A, B>, int> = 0>
+inline auto min(A &&a, B &&b)
+{
+	using T = std::common_type_t<typename decltype(impl::operand(a))::value_type,
+				     typename decltype(impl::operand(b))::value_type>;
+
+	return map([](T const x, T const y) { return std::min(x, y); }, std::forward<A>(a),
+		   std::forward<B>(b));
+}
+
+template <class A, class B, std::enable_if_t<impl::is_operand_v<A, B>, int> = 0>
+inline auto max(A &&a, B &&b)
+{
+	using T = std::common_type_t<typename decltype(impl::operand(a))::value_type,
+				     typename decltype(impl::operand(b))::value_type>;
+
+	return map([](T const x, T const y) { return std::max(x, y); }, std::forward<A>(a),
+		   std::forward<B>(b));
+}
+
+/*
+ * Evaluates the expression for all pixels of the target, row by row if either of them is
+ * padded. The target may also appear in the expression, as each pixel only depends on the
+ * pixels at the same position.
+ */
+template <class T, class E, std::enable_if_t<impl::is_expr_v<E>, int> = 0>
+inline void assign(T &target, E const &expr)
+{
+	assert(target.size() == expr.size());
+
+	auto const size = target.size();
+	auto const stride = expr.stride();
+
+	// without padding, the image is one long row
+	bool const dense = target.stride() == size.x && stride == size.x;
+
+	index_t const rows = dense ? 1 : size.y;
+	index_t const cols = dense ? size.span() : size.x;
+
+	for (index_t y = 0; y < rows; ++y) {
+		auto *const out = target.row(y);
+		index_t const row = y * stride;
+
+		for (index_t x = 0; x < cols; ++x)
+			out[x] = expr[row + x];
+	}
+}
+
+/*
+ * Sum of all pixels of the expression, in the same order as for an image.
+ */
+template <class E, std::enable_if_t<impl::is_expr_v<E>, int> = 0>
+inline auto sum(E const &expr) -> typename E::value_type
+{
+	using T = typename E::value_type;
+
+	auto v = math::num<T>::zero;
+	auto const size = expr.size();
+	auto const stride = expr.stride();
+
+	for (index_t y = 0; y < size.y; ++y) {
+		for (index_t x = 0; x < size.x; ++x)
+			v = v + expr[y * stride + x];
+	}
+
+	return v;
+}
+
+/*
+ * Sum of all elements. Images go through the expression above, so that the padding of an
+ * image is skipped.
+ */
+template <class C, std::enable_if_t<!impl::is_expr_v<C>, int> = 0>
+inline auto sum(C const &container) -> typename C::value_type
 {
 	using T = typename C::value_type;
 
-	return std::accumulate(container.begin(), container.end(), math::num<T>::zero);
+	if constexpr (impl::has_stride_v<C>)
+		return sum(ref(container));
+	else
+		return std::accumulate(container.begin(), container.end(), math::num<T>::zero);
 }
 
 } /* namespace iptsd::container::ops */
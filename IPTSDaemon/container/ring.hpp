@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTAINER_RING_HPP
+#define IPTSD_CONTAINER_RING_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace iptsd::container {
+
+/*
+ * A bounded lock-free queue between exactly one producer thread and one consumer thread.
+ *
+ * The positions only ever grow and are wrapped when indexing, so a full and an empty ring can
+ * be told apart without sacrificing an element. Each side keeps a private copy of the position
+ * of the other side and only reloads it when the ring looks full (or empty), and the positions
+ * of both sides live on separate cache lines, so that the threads do not pull the same cache
+ * line back and forth on every operation.
+ */
+template <class T, std::size_t N> class Ring {
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "Ring: capacity must be a power of two");
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	static constexpr std::size_t capacity = N;
+
+public:
+	/*
+	 * Producer only. Returns false without modifying the ring if it is full.
+	 */
+	bool push(const T &value);
+
+	/*
+	 * Consumer only. Returns false without modifying value if the ring is empty.
+	 */
+	bool pop(T &value);
+
+	/*
+	 * The number of queued elements. Can be called from any thread, but is only a snapshot
+	 * while the other threads are working on the ring.
+	 */
+	[[nodiscard]] std::size_t size() const;
+
+	[[nodiscard]] bool empty() const;
+
+private:
+	static constexpr std::size_t line = 64;
+
+	// written by the producer
+	alignas(line) std::atomic<std::size_t> tail {0};
+	std::size_t head_cache = 0;
+
+	// written by the consumer
+	alignas(line) std::atomic<std::size_t> head {0};
+	std::size_t tail_cache = 0;
+
+	alignas(line) std::array<T, N> data {};
+};
+
+template <class T, std::size_t N> inline bool Ring<T, N>::push(const T &value)
+{
+	const std::size_t t = tail.load(std::memory_order_relaxed);
+
+	if (t - head_cache == N) {
+		head_cache = head.load(std::memory_order_acquire);
+
+		if (t - head_cache == N)
+			return false;
+	}
+
+	data[t & (N - 1)] = value;
+	tail.store(t + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <class T, std::size_t N> inline bool Ring<T, N>::pop(T &value)
+{
+	const std::size_t h = head.load(std::memory_order_relaxed);
+
+	if (h == tail_cache) {
+		tail_cache = tail.load(std::memory_order_acquire);
+
+		if (h == tail_cache)
+			return false;
+	}
+
+	value = data[h & (N - 1)];
+	head.store(h + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <class T, std::size_t N> inline std::size_t Ring<T, N>::size() const
+{
+	// the head can only be behind the tail that is loaded afterwards
+	const std::size_t h = head.load(std::memory_order_acquire);
+	const std::size_t t = tail.load(std::memory_order_acquire);
+
+	return std::min(t - h, N);
+}
+
+template <class T, std::size_t N> inline bool Ring<T, N>::empty() const
+{
+	return size() == 0;
+}
+
+} /* namespace iptsd::container */
+
+#endif /* IPTSD_CONTAINER_RING_HPP */
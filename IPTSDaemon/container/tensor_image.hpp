@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_CONTAINER_TENSOR_IMAGE_HPP
+#define IPTSD_CONTAINER_TENSOR_IMAGE_HPP
+
+#include "image.hpp"
+
+#include <common/types.hpp>
+#include <math/mat2.hpp>
+
+#include <utility>
+
+namespace iptsd::container {
+
+/*
+ * An image of symmetric 2x2 matrices, stored as three separate planes for the xx, xy and yy
+ * components instead of interleaved. Operations that treat the components independently
+ * can work on each plane as a contiguous Image<T>.
+ */
+template <class T> class TensorImage {
+public:
+	using plane_type = Image<T>;
+	using value_type = math::Mat2s<T>;
+
+public:
+	TensorImage();
+	TensorImage(index2_t size);
+	TensorImage(index2_t size, Layout layout);
+	TensorImage(plane_type xx, plane_type xy, plane_type yy);
+
+	[[nodiscard]] auto size() const -> index2_t;
+	[[nodiscard]] auto stride() const -> index_t;
+
+	auto xx() -> plane_type &;
+	auto xy() -> plane_type &;
+	auto yy() -> plane_type &;
+
+	[[nodiscard]] auto xx() const -> plane_type const &;
+	[[nodiscard]] auto xy() const -> plane_type const &;
+	[[nodiscard]] auto yy() const -> plane_type const &;
+
+	auto operator[](index2_t const &i) const -> value_type;
+	auto operator[](index_t const &i) const -> value_type;
+
+	void set(index2_t const &i, value_type const &v);
+	void set(index_t const &i, value_type const &v);
+
+private:
+	index2_t m_size;
+	plane_type m_xx;
+	plane_type m_xy;
+	plane_type m_yy;
+};
+
+template <class T> TensorImage<T>::TensorImage() : m_size {0, 0}, m_xx {}, m_xy {}, m_yy {}
+{}
+
+template <class T>
+TensorImage<T>::TensorImage(index2_t size) : m_size {size}, m_xx {size}, m_xy {size}, m_yy {size}
+{}
+
+template <class T>
+TensorImage<T>::TensorImage(index2_t size, Layout layout)
+	: m_size {size}, m_xx {size, layout}, m_xy {size, layout}, m_yy {size, layout}
+{}
+
+/*
+ * Creates a tensor image from existing planes of the same size and stride, e.g. views into an
+ * Arena.
+ */
+template <class T>
+TensorImage<T>::TensorImage(plane_type xx, plane_type xy, plane_type yy)
+	: m_size {xx.size()}, m_xx {std::move(xx)}, m_xy {std::move(xy)}, m_yy {std::move(yy)}
+{}
+
+template <class T> inline auto TensorImage<T>::size() const -> index2_t
+{
+	return m_size;
+}
+
+template <class T> inline auto TensorImage<T>::stride() const -> index_t
+{
+	return m_xx.stride();
+}
+
+template <class T> inline auto TensorImage<T>::xx() -> plane_type &
+{
+	return m_xx;
+}
+
+template <class T> inline auto TensorImage<T>::xy() -> plane_type &
+{
+	return m_xy;
+}
+
+template <class T> inline auto TensorImage<T>::yy() -> plane_type &
+{
+	return m_yy;
+}
+
+template <class T> inline auto TensorImage<T>::xx() const -> plane_type const &
+{
+	return m_xx;
+}
+
+template <class T> inline auto TensorImage<T>::xy() const -> plane_type const &
+{
+	return m_xy;
+}
+
+template <class T> inline auto TensorImage<T>::yy() const -> plane_type const &
+{
+	return m_yy;
+}
+
+template <class T>
+inline auto TensorImage<T>::operator[](index2_t const &i) const -> value_type
+{
+	return (*this)[m_xx.offset(i)];
+}
+
+template <class T> inline auto TensorImage<T>::operator[](index_t const &i) const -> value_type
+{
+	return {m_xx[i], m_xy[i], m_yy[i]};
+}
+
+template <class T> inline void TensorImage<T>::set(index2_t const &i, value_type const &v)
+{
+	set(m_xx.offset(i), v);
+}
+
+template <class T> inline void TensorImage<T>::set(index_t const &i, value_type const &v)
+{
+	m_xx[i] = v.xx;
+	m_xy[i] = v.xy;
+	m_yy[i] = v.yy;
+}
+
+} /* namespace iptsd::container */
+
+#endif /* IPTSD_CONTAINER_TENSOR_IMAGE_HPP */
@@ -8,28 +8,42 @@
 #include <cmath>
 #include <gsl/gsl>
 #include <gsl/util>
+#include <mutex>
 
 namespace iptsd::daemon {
 
 bool Cone::alive()
 {
+	std::lock_guard<std::mutex> lock {mutex};
+
 	return position_update > clock::from_time_t(0);
 }
 
 void Cone::update_position(Float64 rx, Float64 ry)
 {
+	std::lock_guard<std::mutex> lock {mutex};
+
 	x = rx;
 	y = ry;
 	position_update = clock::now();
 }
 
 bool Cone::active()
+{
+	std::lock_guard<std::mutex> lock {mutex};
+
+	return is_active();
+}
+
+bool Cone::is_active() const
 {
 	return position_update + std::chrono::milliseconds(300) > clock::now();
 }
 
 void Cone::update_direction(Float64 rx, Float64 ry)
 {
+	std::lock_guard<std::mutex> lock {mutex};
+
 	clock::time_point timestamp = clock::now();
 
 	auto time_diff = timestamp - direction_update;
@@ -54,7 +68,9 @@ void Cone::update_direction(Float64 rx, Float64 ry)
 
 bool Cone::check(Float64 rx, Float64 ry)
 {
-	if (!active())
+	std::lock_guard<std::mutex> lock {mutex};
+
+	if (!is_active())
 		return false;
 
     Float64 drx = rx - x;
@@ -70,4 +86,11 @@ bool Cone::check(Float64 rx, Float64 ry)
 	return false;
 }
 
+Float64 Cone::distance_to(Float64 rx, Float64 ry)
+{
+	std::lock_guard<std::mutex> lock {mutex};
+
+	return std::hypot(x - rx, y - ry);
+}
+
 } // namespace iptsd::daemon
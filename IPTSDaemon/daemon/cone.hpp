@@ -7,9 +7,14 @@
 #include <math/num.hpp>
 
 #include <chrono>
+#include <mutex>
 
 namespace iptsd::daemon {
 
+/*
+ * The position is updated by the stylus processing, the direction and the checks happen in
+ * the touch processing. They can run on different threads, so all methods lock the cone.
+ */
 class Cone {
 public:
 	using clock = std::chrono::system_clock;
@@ -35,6 +40,14 @@ public:
 	void update_direction(Float64 rx, Float64 ry);
 
 	bool check(Float64 rx, Float64 ry);
+
+	// distance between the tip of the cone and the given point
+	Float64 distance_to(Float64 rx, Float64 ry);
+
+private:
+	std::mutex mutex;
+
+	bool is_active() const;
 };
 
 } /* namespace iptsd::daemon */
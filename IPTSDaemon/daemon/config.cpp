@@ -82,6 +82,15 @@ static int parse_conf(void *user, const char *c_section, const char *c_name, con
 	if (section == "Touch" && name == "DisableOnPalm")
 		config->touch_disable_on_palm = to_bool(value);
 
+	if (section == "Touch" && name == "Coalesce")
+		config->touch_coalesce = to_bool(value);
+
+	if (section == "Touch" && name == "ApproxMath")
+		config->touch_approx_math = to_bool(value);
+
+	if (section == "Touch" && name == "Activity")
+		config->touch_activity = std::stof(value);
+
 	if (section == "Basic" && name == "Pressure")
 		config->basic_pressure = std::stof(value);
 
@@ -94,6 +103,12 @@ static int parse_conf(void *user, const char *c_section, const char *c_name, con
 	if (section == "Stability" && name == "Threshold")
 		config->stability_threshold = std::stof(value);
 
+	if (section == "Trace" && name == "Enable")
+		config->trace = to_bool(value);
+
+	if (section == "Trace" && name == "File")
+		config->trace_file = value;
+
 	return 1;
 }
 
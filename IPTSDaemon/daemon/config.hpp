@@ -27,6 +27,15 @@ public:
 	bool touch_advanced = false;
 	bool touch_disable_on_palm = false;
 
+	// Faster, but slightly less exact math in the advanced processing
+	bool touch_approx_math = false;
+
+	// Only process the newest heatmap if the processing falls behind, see Pipeline
+	bool touch_coalesce = false;
+
+	// Heatmaps with less contrast are treated as idle by the advanced processing
+	Float32 touch_activity = 0.025;
+
 	Float32 basic_pressure = 0.04;
 
 	Float32 cone_angle = 30;
@@ -34,6 +43,11 @@ public:
 
 	Float32 stability_threshold = 0.1;
 
+	// Record the latency of every stage, the recent history is written to trace_file on SIGUSR2.
+	// There is no default file, the daemon runs as root and should not write to a shared path.
+	bool trace = false;
+	std::string trace_file;
+
 	IPTSDeviceInfo info;
 
 	Config(IPTSDeviceInfo info);
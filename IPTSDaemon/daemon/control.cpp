@@ -58,7 +58,7 @@ void Control::disconnect_from_kernel()
     IOObjectRelease(service);
 }
 
-gsl::span<UInt8> &Control::read_input()
+std::size_t Control::receive()
 {
     UInt64 idx = 0;
     UInt32 output_size = sizeof(UInt8);
@@ -68,7 +68,12 @@ gsl::span<UInt8> &Control::read_input()
         throw common::cerror("Failed to receive input!");
     }
     
-    return buffers[idx];
+    return idx;
+}
+
+gsl::span<UInt8> &Control::read_input()
+{
+    return buffers[receive()];
 }
 
 void Control::send_hid_report(IPTSHIDReport &report) {
@@ -6,6 +6,7 @@
 #include "../../IPTSKenerlUserShared.h"
 
 #include <IOKit/IOKitLib.h>
+#include <cstddef>
 #include <gsl/gsl>
 
 namespace iptsd::daemon {
@@ -23,6 +24,8 @@ public:
     void connect_to_kernel();
     void disconnect_from_kernel();
 
+	// blocks until the driver has filled a buffer and returns its index
+	std::size_t receive();
 	gsl::span<UInt8> &read_input();
     void send_hid_report(IPTSHIDReport &report);
     void reset();
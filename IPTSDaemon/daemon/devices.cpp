@@ -2,6 +2,7 @@
 
 #include "devices.hpp"
 #include "config.hpp"
+#include "trace.hpp"
 
 #include <common/types.hpp>
 
@@ -34,6 +35,8 @@ bool TouchDevice::process_heatmap_input(const Heatmap &data, IPTSHIDReport &repo
     
     const std::vector<TouchInput> &inputs = manager.process(data);
 
+    trace::Scope scope {trace::Stage::report};
+
     if (disable_on_palm) {
         for (const auto &p : inputs) {
             if (p.palm)
@@ -157,14 +160,14 @@ DeviceManager::DeviceManager(IPTSDeviceInfo info) : conf(Config(info)), touch(co
 	if (conf.width == 0 || conf.height == 0)
 		throw std::runtime_error("Display size is 0");
 
-    touch.manager.cones.push_back(dft_stylus.cone);
+    touch.manager.add_cone(dft_stylus.cone);
     create_stylus(0);
 }
 
 StylusDevice &DeviceManager::create_stylus(UInt32 serial)
 {
 	std::shared_ptr<Cone> cone = std::make_shared<Cone>(conf.cone_angle, conf.cone_distance);
-	touch.manager.cones.push_back(cone);
+	touch.manager.add_cone(cone);
 	return stylus_list.emplace_back(conf.stylus_cone, serial, std::move(cone));
 }
 
@@ -10,6 +10,7 @@
 
 #include <common/types.hpp>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <gsl/gsl>
@@ -114,7 +115,8 @@ public:
 	TouchDevice touch;
     DFTStylusDevice dft_stylus;
 	std::vector<StylusDevice> stylus_list;
-	UInt32 active_stylus_cnt = 0;
+	// written by the stylus processing, read by the touch processing
+	std::atomic<UInt32> active_stylus_cnt {0};
 
 	DeviceManager(IPTSDeviceInfo info);
 
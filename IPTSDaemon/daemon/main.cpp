@@ -16,72 +16,72 @@
 #include <exception>
 #include <fmt/format.h>
 #include <functional>
+#include <memory>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 
 #include "control.hpp"
-#include "parser.hpp"
 #include "devices.hpp"
+#include "pipeline.hpp"
+#include "trace.hpp"
 
 using namespace std::chrono;
 
 namespace iptsd::daemon {
 
+static void log_stats(const Pipeline::Stats &stats)
+{
+    auto const log = [](const char *name, const Pipeline::Queue &queue, const char *full) {
+        spdlog::info("Pipeline: {}: {} queued, {} {}, {} stale, peak {}", name, queue.pushed,
+                     queue.full, full, queue.stale, queue.peak);
+    };
+
+    log("touch", stats.touch, "dropped");
+    log("stylus", stats.stylus, "stalls");
+    log("touch reports", stats.touch_reports, "stalls");
+    log("stylus reports", stats.stylus_reports, "stalls");
+
+    spdlog::info("Pipeline: heatmaps: {} published, {} dropped, {} coalesced",
+                 stats.heatmaps.published, stats.heatmaps.dropped, stats.heatmaps.coalesced);
+}
+
 static int main()
 {
     std::atomic_bool should_exit {false};
     std::atomic_bool should_reset {false};
+    std::atomic_bool should_dump {false};
     auto const _sigusr1 = common::signal<SIGUSR1>([&](int) { should_reset = true; });
+    auto const _sigusr2 = common::signal<SIGUSR2>([&](int) { should_dump = true; });
     auto const _sigterm = common::signal<SIGTERM>([&](int) { should_exit = true; });
     auto const _sigint = common::signal<SIGINT>([&](int) { should_exit = true; });
 
     Control ctrl;
-    Parser parser;
     DeviceManager devices(ctrl.info);
     
 	spdlog::info("Connected to device {:04X}:{:04X}", ctrl.info.vendor_id, ctrl.info.product_id);
 
-	parser.on_singletouch = [&](const auto &data) {
-        IPTSHIDReport report;
-        devices.touch.process_singletouch_input(data, report);
-        ctrl.send_hid_report(report);
-    };
-    parser.on_heatmap = [&](const auto &data) {
-        if (devices.active_stylus_cnt > 0 && devices.conf.stylus_disable_touch)
-            return;
-        IPTSHIDReport report;
-        if (devices.touch.process_heatmap_input(data, report))
-            ctrl.send_hid_report(report);
-    };
-    parser.on_stylus = [&](const auto &data) {
-        StylusDevice &stylus = devices.get_stylus(data.serial);
-        IPTSHIDReport report;
-        int status = stylus.process_stylus_input(data, report);
-        ctrl.send_hid_report(report);
-        devices.active_stylus_cnt += status;
-    };
-    parser.on_dft_stylus = [&](const auto &data) {
-        DFTStylusDevice &stylus = devices.dft_stylus;
-        IPTSHIDReport report;
-        int status = stylus.process_dft_stylus_input(data, report);
-        if (status < -1)
-            return;
-        ctrl.send_hid_report(report);
-        devices.active_stylus_cnt += status;
+    trace::enabled = devices.conf.trace;
+    trace::thread("input");
+
+    auto start = [&]() {
+        return std::make_unique<Pipeline>(devices, ctrl.buffers,
+                                          [&](IPTSHIDReport &report) { ctrl.send_hid_report(report); });
     };
 
+    // This thread only receives buffers, they are processed and sent by the pipeline
+    std::unique_ptr<Pipeline> pipeline = start();
+
 	while (true) {
         try {
-            gsl::span<UInt8> &data = ctrl.read_input();
-            parser.prepare(&data);
-            parser.parse();
-        } catch (std::out_of_range &e) {
-            spdlog::error(e.what());
+            pipeline->submit(ctrl.receive());
         } catch (std::system_error &e) {
             if (ctrl.should_reinit) {
+                // The buffers get unmapped, nothing may be working on them
+                pipeline.reset();
                 ctrl.disconnect_from_kernel();
                 sleep(2);
                 ctrl.connect_to_kernel();
+                pipeline = start();
             }
             spdlog::error(e.what());
         }
@@ -91,8 +91,25 @@ static int main()
 			ctrl.reset();
 			should_reset = false;
 		}
+		if (should_dump) {
+			should_dump = false;
+
+			try {
+				if (devices.conf.trace_file.empty())
+					spdlog::warn("Not writing the trace, no file is configured");
+				else {
+					std::size_t n = trace::dump(devices.conf.trace_file);
+					spdlog::info("Wrote {} trace spans to {}", n,
+						     devices.conf.trace_file);
+				}
+			} catch (std::system_error &e) {
+				spdlog::error(e.what());
+			}
+		}
 		if (should_exit) {
 			spdlog::info("Stopping");
+			pipeline->stop();
+			log_stats(pipeline->stats());
 			return EXIT_FAILURE;
 		}
 	}
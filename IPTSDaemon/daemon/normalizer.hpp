@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_DAEMON_NORMALIZER_HPP
+#define IPTSD_DAEMON_NORMALIZER_HPP
+
+#include <common/simd.hpp>
+#include <common/types.hpp>
+
+#include <array>
+#include <cstddef>
+#include <gsl/gsl>
+
+namespace iptsd::daemon {
+
+namespace impl {
+
+inline void normalize_scalar(UInt8 const *in, std::size_t n, Float32 const *lut, Float32 *out)
+{
+#pragma GCC unroll 8
+	for (std::size_t i = 0; i < n; i++)
+		out[i] = lut[in[i]];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * Eight values at a time: widen the bytes to 32 bit indices and gather the table entries.
+ */
+__attribute__((target("avx2"))) inline void normalize_avx2(UInt8 const *in, std::size_t n,
+							     Float32 const *lut, Float32 *out)
+{
+	std::size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i const b = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(in + i));
+		__m256i const idx = _mm256_cvtepu8_epi32(b);
+
+		_mm256_storeu_ps(out + i, _mm256_i32gather_ps(lut, idx, 4));
+	}
+
+	normalize_scalar(in + i, n - i, lut, out + i);
+}
+#endif
+
+} /* namespace impl */
+
+/*
+ * Converts raw heatmaps from the sensor range [z_min, z_max] to the inverted range [0, 1]
+ * expected by the touch processor.
+ *
+ * A raw value has only 256 possible values, so all of them are converted once into a table,
+ * which is rebuilt only when the range reported by the device changes. The per-pixel work is
+ * then a table lookup instead of a subtraction, a division and a conversion. The table uses the
+ * same formula as the direct conversion, so the results are identical.
+ */
+class Normalizer {
+public:
+	void operator()(gsl::span<UInt8 const> in, UInt8 z_min, UInt8 z_max, Float32 *out);
+
+	/*
+	 * The direct conversion of a single value.
+	 */
+	static Float32 convert(UInt8 v, UInt8 z_min, UInt8 z_max);
+
+private:
+	void rebuild(UInt8 z_min, UInt8 z_max);
+
+	std::array<Float32, 256> lut {};
+
+	UInt8 min = 0;
+	UInt8 max = 0;
+	bool valid = false;
+};
+
+inline Float32 Normalizer::convert(UInt8 v, UInt8 z_min, UInt8 z_max)
+{
+	Float32 val = static_cast<Float32>(v - z_min) / static_cast<Float32>(z_max - z_min);
+
+	return 1.0f - val;
+}
+
+inline void Normalizer::rebuild(UInt8 z_min, UInt8 z_max)
+{
+	for (std::size_t i = 0; i < lut.size(); i++)
+		lut[i] = convert(static_cast<UInt8>(i), z_min, z_max);
+
+	min = z_min;
+	max = z_max;
+	valid = true;
+}
+
+inline void Normalizer::operator()(gsl::span<UInt8 const> in, UInt8 z_min, UInt8 z_max,
+				   Float32 *out)
+{
+	if (!valid || z_min != min || z_max != max)
+		rebuild(z_min, z_max);
+
+	auto const n = static_cast<std::size_t>(in.size());
+
+	switch (common::simd::isa()) {
+#if defined(__x86_64__) || defined(__i386__)
+	case common::simd::Isa::avx2:
+		impl::normalize_avx2(in.data(), n, lut.data(), out);
+		break;
+#endif
+	default:
+		impl::normalize_scalar(in.data(), n, lut.data(), out);
+		break;
+	}
+}
+
+} /* namespace iptsd::daemon */
+
+#endif /* IPTSD_DAEMON_NORMALIZER_HPP */
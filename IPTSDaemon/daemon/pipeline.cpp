@@ -0,0 +1,348 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "pipeline.hpp"
+
+#include "devices.hpp"
+#include "parser.hpp"
+#include "trace.hpp"
+
+#include <common/types.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <gsl/gsl>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace iptsd::daemon {
+
+void Wakeup::notify()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (!waiting.load(std::memory_order_relaxed))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock {mutex};
+		pending = true;
+	}
+
+	cv.notify_one();
+}
+
+void Wakeup::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock {mutex};
+		stopped = true;
+	}
+
+	cv.notify_all();
+}
+
+Pipeline::Queue Pipeline::Counters::load() const
+{
+	return Queue {pushed.load(std::memory_order_relaxed), full.load(std::memory_order_relaxed),
+		      stale.load(std::memory_order_relaxed), peak.load(std::memory_order_relaxed)};
+}
+
+/*
+ * The counters of a ring are only written by its producer, so plain loads and stores suffice.
+ */
+void Pipeline::Counters::push(std::size_t size)
+{
+	pushed.store(pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	if (size > peak.load(std::memory_order_relaxed))
+		peak.store(size, std::memory_order_relaxed);
+}
+
+UInt64 Pipeline::Counters::overflow()
+{
+	UInt64 n = full.load(std::memory_order_relaxed) + 1;
+	full.store(n, std::memory_order_relaxed);
+
+	return n;
+}
+
+Pipeline::Stage::Stage(const char *name, bool lossless) : name(name), lossless(lossless)
+{
+}
+
+Pipeline::Pipeline(DeviceManager &devices, gsl::span<gsl::span<UInt8>> buffers, Sender send)
+	: devices(devices), buffers(buffers), send(std::move(send)),
+	  coalesce(devices.conf.touch_coalesce), touch("touch", false), stylus("stylus", true)
+{
+	touch.parser.on_singletouch = [&](const auto &data) {
+		IPTSHIDReport report;
+		devices.touch.process_singletouch_input(data, report);
+		emit(touch, report);
+	};
+	touch.parser.on_heatmap = [&](const auto &data) { process_heatmap(data); };
+	stylus.parser.on_stylus = [&](const auto &data) {
+		trace::timestamp(data.timestamp);
+		trace::Scope scope {trace::Stage::stylus};
+
+		StylusDevice &device = devices.get_stylus(data.serial);
+		IPTSHIDReport report;
+		int status = device.process_stylus_input(data, report);
+		scope.stop();
+		emit(stylus, report);
+		devices.active_stylus_cnt += status;
+	};
+	stylus.parser.on_dft_stylus = [&](const auto &data) {
+		trace::timestamp(data.timestamp);
+		trace::Scope scope {trace::Stage::stylus};
+
+		DFTStylusDevice &device = devices.dft_stylus;
+		IPTSHIDReport report;
+		int status = device.process_dft_stylus_input(data, report);
+		scope.stop();
+		if (status < -1)
+			return;
+		emit(stylus, report);
+		devices.active_stylus_cnt += status;
+	};
+
+	if (coalesce) {
+		stylus.parser.on_heatmap = [&](const auto &data) { publish(data); };
+
+		// singletouch reports are cheap, they can go with the stylus reports
+		stylus.parser.on_singletouch = [&](const auto &data) {
+			IPTSHIDReport report;
+			devices.touch.process_singletouch_input(data, report);
+			emit(stylus, report);
+		};
+	}
+
+	sender = std::thread {[&] {
+		trace::thread("sender");
+		transmit();
+	}};
+	touch.thread = std::thread {[&] {
+		trace::thread(touch.name);
+
+		if (coalesce)
+			process_latest();
+		else
+			process(touch);
+	}};
+	stylus.thread = std::thread {[&] {
+		trace::thread(stylus.name);
+		process(stylus);
+	}};
+}
+
+Pipeline::~Pipeline()
+{
+	stop();
+}
+
+void Pipeline::submit(std::size_t buffer)
+{
+	UInt64 sequence = received.load(std::memory_order_relaxed);
+	received.store(sequence + 1, std::memory_order_relaxed);
+
+	trace::frame(sequence);
+	trace::Scope scope {trace::Stage::receive};
+
+	for (Stage *stage : {&touch, &stylus}) {
+		// the heatmaps reach the touch thread through the stylus thread
+		if (stage == &touch && coalesce)
+			continue;
+
+		const Input in {buffer, sequence};
+
+		if (!stage->input.push(in)) {
+			UInt64 full = stage->input_counters.overflow();
+
+			if (!stage->lossless) {
+				// Only log the first time, the counters tell how often it happens
+				if (full == 1)
+					spdlog::warn("Pipeline: {} processing is falling behind, "
+						     "dropping input",
+						     stage->name);
+
+				continue;
+			}
+
+			do {
+				stage->wakeup.notify();
+				std::this_thread::yield();
+			} while (!stage->input.push(in));
+		}
+
+		stage->input_counters.push(stage->input.size());
+		stage->wakeup.notify();
+	}
+}
+
+bool Pipeline::full() const
+{
+	return touch.input.size() == input_capacity || stylus.input.size() == input_capacity;
+}
+
+void Pipeline::stop()
+{
+	if (!running)
+		return;
+
+	running = false;
+
+	// the processing threads have to finish first, they still produce reports, and the
+	// stylus thread still produces heatmaps for the touch thread
+	for (Stage *stage : {&stylus, &touch}) {
+		stage->wakeup.stop();
+		stage->thread.join();
+	}
+
+	sender_wakeup.stop();
+	sender.join();
+}
+
+Pipeline::Stats Pipeline::stats() const
+{
+	const Frames heatmaps {frames.published(), frames.dropped(),
+			       coalesced.load(std::memory_order_relaxed)};
+
+	return Stats {heatmaps, touch.input_counters.load(), stylus.input_counters.load(),
+		      touch.report_counters.load(), stylus.report_counters.load()};
+}
+
+void Pipeline::process(Stage &stage)
+{
+	Input in {};
+
+	do {
+		while (stage.input.pop(in)) {
+			UInt64 age = received.load(std::memory_order_relaxed) - in.sequence;
+
+			// A lossless stage never has more than input_capacity buffers queued, as the
+			// caller waits for it. The age still grows by one while the caller waits, and
+			// such a buffer has not been reused by the driver yet.
+			if (!stage.lossless && age > input_capacity) {
+				UInt64 stale = stage.input_counters.stale.load(std::memory_order_relaxed);
+				stage.input_counters.stale.store(stale + 1, std::memory_order_relaxed);
+				continue;
+			}
+
+			trace::frame(in.sequence);
+			trace::Scope scope {trace::Stage::parse};
+
+			try {
+				stage.parser.prepare(&buffers[in.buffer]);
+				stage.parser.parse();
+			} catch (std::out_of_range &e) {
+				spdlog::error(e.what());
+			} catch (std::exception &e) {
+				spdlog::error("Pipeline: {} processing failed: {}", stage.name, e.what());
+			}
+		}
+	} while (stage.wakeup.wait([&] { return !stage.input.empty(); }));
+}
+
+void Pipeline::process_latest()
+{
+	UInt64 next = 0;
+
+	do {
+		while (Frame *frame = frames.take()) {
+			// the heatmaps in between were replaced before this thread got to them
+			if (frame->sequence != next)
+				coalesced.store(coalesced.load(std::memory_order_relaxed) + 1,
+						std::memory_order_relaxed);
+
+			next = frame->sequence + 1;
+
+			trace::frame(frame->input, frame->heatmap.timestamp);
+
+			try {
+				process_heatmap(frame->heatmap);
+			} catch (std::exception &e) {
+				spdlog::error("Pipeline: touch processing failed: {}", e.what());
+			}
+		}
+	} while (touch.wakeup.wait([&] { return frames.ready(); }));
+}
+
+void Pipeline::process_heatmap(const Heatmap &data)
+{
+	if (devices.active_stylus_cnt > 0 && devices.conf.stylus_disable_touch)
+		return;
+
+	trace::timestamp(data.timestamp);
+	trace::Scope scope {trace::Stage::touch};
+
+	IPTSHIDReport report;
+	bool valid = devices.touch.process_heatmap_input(data, report);
+	scope.stop();
+
+	if (valid)
+		emit(touch, report);
+}
+
+/*
+ * The heatmap points into a buffer of the driver, which is going to be reused while the touch
+ * thread may still be working on it, so it has to be copied.
+ */
+void Pipeline::publish(const Heatmap &data)
+{
+	Frame &frame = frames.slot();
+
+	frame.data.assign(data.data.begin(), data.data.end());
+	frame.heatmap = data;
+	frame.heatmap.data = gsl::span<UInt8>(frame.data);
+	frame.sequence = frames.published();
+	frame.input = trace::current.frame;
+
+	frames.publish();
+	touch.wakeup.notify();
+}
+
+void Pipeline::emit(Stage &stage, IPTSHIDReport &report)
+{
+	const Output out {report, trace::current.frame, trace::current.timestamp};
+
+	if (!stage.reports.push(out)) {
+		stage.report_counters.overflow();
+
+		// The sender only makes one call to the driver per report, it will be done soon
+		do {
+			sender_wakeup.notify();
+			std::this_thread::yield();
+		} while (!stage.reports.push(out));
+	}
+
+	stage.report_counters.push(stage.reports.size());
+	sender_wakeup.notify();
+}
+
+void Pipeline::transmit()
+{
+	Output out {};
+
+	do {
+		// stylus reports first, their latency is the most noticeable
+		for (Stage *stage : {&stylus, &touch}) {
+			while (stage->reports.pop(out)) {
+				trace::frame(out.frame, out.timestamp);
+				trace::Scope scope {trace::Stage::send};
+
+				try {
+					send(out.report);
+				} catch (std::exception &e) {
+					spdlog::error(e.what());
+				}
+			}
+		}
+	} while (sender_wakeup.wait(
+		[&] { return !touch.reports.empty() || !stylus.reports.empty(); }));
+}
+
+} // namespace iptsd::daemon
@@ -0,0 +1,247 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_DAEMON_PIPELINE_HPP
+#define IPTSD_DAEMON_PIPELINE_HPP
+
+#include "../../IPTSKenerlUserShared.h"
+
+#include "devices.hpp"
+#include "parser.hpp"
+
+#include <common/types.hpp>
+#include <container/mailbox.hpp>
+#include <container/ring.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <gsl/gsl>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iptsd::daemon {
+
+/*
+ * Lets a thread sleep until one of the rings it consumes has new elements. notify() is a
+ * fence and a load unless the consumer is actually sleeping, so producers can call it after
+ * every push.
+ */
+class Wakeup {
+public:
+	void notify();
+
+	/*
+	 * Wakes up the consumer for good, wait() returns false once nothing is ready anymore.
+	 */
+	void stop();
+
+	/*
+	 * Sleeps until ready() returns true, notify() or stop() is called. Returns false if the
+	 * consumer has been stopped and ready() is false.
+	 */
+	template <class F> bool wait(F ready);
+
+private:
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	std::atomic_bool waiting {false};
+	bool pending = false;
+	bool stopped = false;
+};
+
+/*
+ * Processes the input buffers of the driver on multiple threads:
+ *
+ *   input (caller) --> touch  --\
+ *                  \-> stylus ---> sender
+ *
+ * The caller only receives buffer indices from the driver and hands them to submit(). The
+ * touch and the stylus thread each parse every buffer, but only process the reports of their
+ * modality, so a slow heatmap does not delay the stylus reports of the next buffer. The HID
+ * reports are sent from a separate thread. All stages are connected by bounded single-producer
+ * single-consumer rings.
+ *
+ * If the touch thread falls behind, its input ring fills up and new buffers are dropped for
+ * it, as the driver is going to reuse the buffer anyway. For the same reason it skips queued
+ * buffers once more than input_capacity newer ones have been received. The stylus processing
+ * is cheap and never loses a buffer, if it falls behind the caller waits for it. If the sender
+ * falls behind, the processing threads wait for it, so that no report is lost.
+ *
+ * With coalescing (Config::touch_coalesce), the touch thread does not parse the buffers and
+ * does not process every heatmap in order. Instead the stylus thread copies every heatmap
+ * into a latest-wins mailbox, and the touch thread only processes the newest one once it is
+ * done with the previous one. If the processing is slower than the sensor, frames are skipped
+ * instead of piling up latency. Singletouch reports are then handled by the stylus thread.
+ *
+ * The sequence number of a buffer is its frame number in the trace (see trace.hpp), and it is
+ * passed along with the reports, so that the spans of all threads can be matched up.
+ */
+class Pipeline {
+public:
+	/*
+	 * Back-pressure counters of a ring. full is the number of buffers that were dropped for
+	 * the touch input ring, and the number of times the producer had to wait for the consumer
+	 * for the other rings. stale is the number of queued buffers that were skipped because
+	 * the driver may have reused them already. peak is the largest number of queued elements.
+	 */
+	struct Queue {
+		UInt64 pushed = 0;
+		UInt64 full = 0;
+		UInt64 stale = 0;
+		std::size_t peak = 0;
+	};
+
+	/*
+	 * Counters of the heatmap mailbox. dropped is the number of heatmaps that were replaced
+	 * by a newer one before processing, coalesced the number of processed heatmaps that
+	 * replaced at least one.
+	 */
+	struct Frames {
+		UInt64 published = 0;
+		UInt64 dropped = 0;
+		UInt64 coalesced = 0;
+	};
+
+	struct Stats {
+		Frames heatmaps;
+		Queue touch;
+		Queue stylus;
+		Queue touch_reports;
+		Queue stylus_reports;
+	};
+
+	using Sender = std::function<void(IPTSHIDReport &)>;
+
+	// less than the number of driver buffers, so that a queued buffer is not overwritten yet
+	static constexpr std::size_t input_capacity = IPTS_BUFFER_NUM / 2;
+	static constexpr std::size_t report_capacity = 16;
+
+public:
+	Pipeline(DeviceManager &devices, gsl::span<gsl::span<UInt8>> buffers, Sender send);
+	~Pipeline();
+
+	Pipeline(const Pipeline &) = delete;
+	Pipeline &operator=(const Pipeline &) = delete;
+
+	/*
+	 * Queues the buffer with the given index for processing. Must always be called from the
+	 * same thread.
+	 */
+	void submit(std::size_t buffer);
+
+	/*
+	 * Whether submit() would drop the next buffer or wait for one of the stages. Only
+	 * meaningful on the thread that calls submit().
+	 */
+	[[nodiscard]] bool full() const;
+
+	/*
+	 * Processes everything that has been submitted so far and stops the threads.
+	 */
+	void stop();
+
+	[[nodiscard]] Stats stats() const;
+
+private:
+	struct Counters {
+		std::atomic<UInt64> pushed {0};
+		std::atomic<UInt64> full {0};
+		std::atomic<std::size_t> peak {0};
+
+		// written by the consumer
+		std::atomic<UInt64> stale {0};
+
+		void push(std::size_t size);
+		UInt64 overflow();
+
+		[[nodiscard]] Queue load() const;
+	};
+
+	// a buffer index and the number of buffers that were received before it
+	struct Input {
+		std::size_t buffer;
+		UInt64 sequence;
+	};
+
+	// a report and the frame it was produced from, for tracing
+	struct Output {
+		IPTSHIDReport report;
+		UInt64 frame;
+		UInt32 timestamp;
+	};
+
+	struct Stage {
+		Stage(const char *name, bool lossless);
+
+		const char *name;
+		bool lossless;
+		Parser parser;
+
+		container::Ring<Input, input_capacity> input;
+		container::Ring<Output, report_capacity> reports;
+
+		Counters input_counters;
+		Counters report_counters;
+
+		Wakeup wakeup;
+		std::thread thread;
+	};
+
+	DeviceManager &devices;
+	gsl::span<gsl::span<UInt8>> buffers;
+	Sender send;
+
+	struct Frame {
+		Heatmap heatmap;
+		std::vector<UInt8> data;
+		UInt64 sequence = 0;
+
+		// the input the heatmap was parsed from
+		UInt64 input = 0;
+	};
+
+	bool coalesce;
+	container::Mailbox<Frame> frames;
+	std::atomic<UInt64> coalesced {0};
+
+	Stage touch;
+	Stage stylus;
+
+	Wakeup sender_wakeup;
+	std::thread sender;
+
+	std::atomic<UInt64> received {0};
+
+	bool running = true;
+
+	void process(Stage &stage);
+	void process_latest();
+	void process_heatmap(const Heatmap &data);
+	void publish(const Heatmap &data);
+	void emit(Stage &stage, IPTSHIDReport &report);
+	void transmit();
+};
+
+template <class F> bool Wakeup::wait(F ready)
+{
+	std::unique_lock<std::mutex> lock {mutex};
+
+	// pairs with the fence in notify(): either the producer sees that we are waiting, or we
+	// see what it pushed
+	waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	cv.wait(lock, [&] { return pending || stopped || ready(); });
+
+	waiting.store(false, std::memory_order_relaxed);
+	pending = false;
+
+	return !stopped || ready();
+}
+
+} /* namespace iptsd::daemon */
+
+#endif /* IPTSD_DAEMON_PIPELINE_HPP */
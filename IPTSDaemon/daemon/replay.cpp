@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "replay.hpp"
+#include "parser.hpp"
+
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <thread>
+
+namespace iptsd::daemon {
+
+Replay::Replay(const std::string &path, IPTSDeviceInfo info, Mode mode) : info(info), mode(mode)
+{
+	load(path);
+
+	if (mode == Mode::paced)
+		scan_timestamps();
+}
+
+void Replay::load(const std::string &path)
+{
+	std::ifstream file;
+	file.exceptions(std::ios::badbit | std::ios::failbit);
+	file.open(path, std::ios::in | std::ios::binary);
+
+	file.seekg(0, std::ios::end);
+	capture.resize(file.tellg());
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char *>(capture.data()), capture.size());
+
+	size_t offset = 0;
+	size_t buffer_size = 0;
+	while (offset + sizeof(IPTSDataHeader) <= capture.size()) {
+		IPTSDataHeader header;
+		std::memcpy(&header, &capture[offset], sizeof(IPTSDataHeader));
+
+		size_t size = sizeof(IPTSDataHeader) + header.size;
+		if (offset + size > capture.size()) {
+			spdlog::warn("Ignoring truncated buffer at the end of {}", path);
+			break;
+		}
+
+		frame_list.push_back(Frame {offset, size, false, 0});
+		buffer_size = std::max(buffer_size, size);
+		offset += size;
+	}
+
+	if (frame_list.empty())
+		throw std::runtime_error(path + " does not contain any buffers");
+
+	// Every slot has the same size, like the buffers mapped from the driver
+	storage.resize(buffer_size * IPTS_BUFFER_NUM);
+	for (int i = 0; i < IPTS_BUFFER_NUM; i++)
+		buffers[i] = gsl::span(&storage[buffer_size * i], buffer_size);
+}
+
+void Replay::scan_timestamps()
+{
+	Parser parser;
+	Frame *current = nullptr;
+
+	parser.on_heatmap = [&](const auto &data) {
+		current->has_timestamp = true;
+		current->timestamp = data.timestamp;
+	};
+
+	for (Frame &frame : frame_list) {
+		gsl::span<UInt8> data(&capture[frame.offset], frame.size);
+		current = &frame;
+
+		try {
+			parser.prepare(&data);
+			parser.parse();
+		} catch (std::out_of_range &e) {
+			// Malformed buffers will be reported when they are replayed
+		}
+	}
+}
+
+void Replay::wait(const Frame &frame)
+{
+	if (!frame.has_timestamp)
+		return;
+
+	if (!has_last) {
+		has_last = true;
+		last_timestamp = frame.timestamp;
+		last_time = clock::now();
+		return;
+	}
+
+	// Unsigned subtraction handles a wrap-around of the sensor clock
+	UInt32 ticks = frame.timestamp - last_timestamp;
+	auto delta = tick * ticks;
+	last_timestamp = frame.timestamp;
+
+	// The sensor stops sending heatmaps while it is idle, don't replay the silence
+	if (delta > std::chrono::seconds(1)) {
+		last_time = clock::now();
+		return;
+	}
+
+	last_time += std::chrono::duration_cast<clock::duration>(delta);
+	std::this_thread::sleep_until(last_time);
+}
+
+std::size_t Replay::receive()
+{
+	if (next >= frame_list.size()) {
+		if (!loop)
+			throw std::out_of_range("End of capture");
+
+		next = 0;
+		has_last = false;
+	}
+
+	const Frame &frame = frame_list[next++];
+	if (mode == Mode::paced)
+		wait(frame);
+
+	std::size_t idx = slot++ % IPTS_BUFFER_NUM;
+	std::memcpy(buffers[idx].data(), &capture[frame.offset], frame.size);
+
+	return idx;
+}
+
+gsl::span<UInt8> &Replay::read_input()
+{
+	return buffers[receive()];
+}
+
+void Replay::send_hid_report(IPTSHIDReport &report)
+{
+	(void)report;
+	reports++;
+}
+
+void Replay::reset()
+{
+	// the capture is read-only, there is no sensor state that could get stuck
+}
+
+void Replay::rewind()
+{
+	next = 0;
+	slot = 0;
+	has_last = false;
+}
+
+bool Replay::eof() const
+{
+	return !loop && next >= frame_list.size();
+}
+
+size_t Replay::frames() const
+{
+	return frame_list.size();
+}
+
+} // namespace iptsd::daemon
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_DAEMON_REPLAY_HPP
+#define IPTSD_DAEMON_REPLAY_HPP
+
+#include "../../IPTSKenerlUserShared.h"
+
+#include <common/types.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <gsl/gsl>
+#include <string>
+#include <vector>
+
+namespace iptsd::daemon {
+
+/*
+ * Input source that replays a capture written by debug/dump.cpp, i.e. a sequence of
+ * IPTSDataHeader-framed buffers. It mirrors the interface of Control, so that the
+ * parser and the device handling can be driven without the kernel driver.
+ */
+class Replay {
+public:
+	enum class Mode {
+		fast,   // Hand out buffers as fast as they are consumed
+		paced,  // Hand out buffers at the rate given by the sensor timestamps
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	IPTSDeviceInfo info;
+	gsl::span<UInt8> buffers[IPTS_BUFFER_NUM];
+
+	bool should_reinit = false;
+	bool loop = false;
+
+	// Duration of one tick of the heatmap timestamp, used by the paced mode
+	std::chrono::nanoseconds tick = std::chrono::microseconds(1);
+
+	UInt64 reports = 0;
+
+	Replay(const std::string &path, IPTSDeviceInfo info, Mode mode = Mode::fast);
+
+	std::size_t receive();
+	gsl::span<UInt8> &read_input();
+	void send_hid_report(IPTSHIDReport &report);
+	void reset();
+	void rewind();
+
+	[[nodiscard]] bool eof() const;
+	[[nodiscard]] size_t frames() const;
+
+private:
+	struct Frame {
+		size_t offset;
+		size_t size;
+		bool has_timestamp;
+		UInt32 timestamp;
+	};
+
+	Mode mode;
+
+	std::vector<UInt8> capture;
+	std::vector<Frame> frame_list;
+	std::vector<UInt8> storage;
+
+	size_t next = 0;
+	UInt64 slot = 0;
+
+	bool has_last = false;
+	UInt32 last_timestamp = 0;
+	clock::time_point last_time;
+
+	void load(const std::string &path);
+	void scan_timestamps();
+	void wait(const Frame &frame);
+};
+
+} /* namespace iptsd::daemon */
+
+#endif /* IPTSD_DAEMON_REPLAY_HPP */
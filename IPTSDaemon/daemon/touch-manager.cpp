@@ -4,6 +4,7 @@
 
 #include "config.hpp"
 #include "devices.hpp"
+#include "trace.hpp"
 
 #include <common/types.hpp>
 #include <common/cerror.hpp>
@@ -18,6 +19,7 @@
 #include <gsl/gsl>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <spdlog/spdlog.h>
 #include <utility>
 #include <vector>
@@ -34,22 +36,61 @@ TouchManager::TouchManager(const Config &conf)
 	}
 
 	processor.advanced = conf.touch_advanced;
+	processor.approx_math = conf.touch_approx_math;
 	processor.conf.basic_pressure = conf.basic_pressure;
 }
 
+/*
+ * Cheap check on the raw heatmap whether the touch processor can find anything in it.
+ * The sensor values are inverted, a contact shows up as a low value.
+ */
+bool TouchManager::is_active(const Heatmap &data) const
+{
+	if (data.data.empty() || data.z_max <= data.z_min)
+		return true;
+
+	UInt8 min = data.z_max;
+	UInt32 sum = 0;
+
+	for (UInt8 v : data.data) {
+		min = std::min(min, v);
+		sum += v;
+	}
+
+	Float32 range = static_cast<Float32>(data.z_max - data.z_min);
+
+	// The basic processing only looks at values above the pressure threshold
+	if (!processor.advanced)
+		return 1.0f - static_cast<Float32>(min - data.z_min) / range >= conf.basic_pressure;
+
+	/*
+	 * The advanced processing only looks at local maxima that stand out from the average
+	 * of the heatmap. Smoothing can only lower the peak, so if the highest value is close
+	 * to the average, there is nothing to find.
+	 */
+	Float32 avg = static_cast<Float32>(sum) / static_cast<Float32>(data.data.size());
+
+	return (avg - static_cast<Float32>(min)) / range >= conf.touch_activity;
+}
+
 std::vector<TouchInput> &TouchManager::process(const Heatmap &data)
 {
+	static const std::vector<contacts::TouchPoint> idle {};
+
 	processor.resize(index2_t {data.width, data.height});
 
-	std::transform(data.data.begin(), data.data.end(), processor.hm().begin(),
-		       [&](auto v) {
-			       Float32 val = static_cast<Float32>(v - data.z_min) /
-					 static_cast<Float32>(data.z_max - data.z_min);
+	trace::Scope find {trace::Stage::contacts};
+
+	bool active = is_active(data);
+
+	if (active)
+		normalize(data.data, data.z_min, data.z_max, processor.hm().data());
+	else
+		processor.idle();
 
-			       return 1.0f - val;
-		       });
+	const std::vector<contacts::TouchPoint> &contacts = active ? processor.process() : idle;
 
-	const std::vector<contacts::TouchPoint> &contacts = processor.process();
+	find.stop();
 
 	UInt8 max_contacts = conf.info.max_contacts;
 	UInt8 count = std::min(gsl::narrow_cast<UInt8>(contacts.size()), max_contacts);
@@ -116,10 +157,15 @@ std::vector<TouchInput> &TouchManager::process(const Heatmap &data)
 		inputs[i].ev2 = 0;
 	}
 
-    if (touching)
+    if (touching) {
+        trace::Scope scope {trace::Stage::tracking};
         track(actual_cnt);
+    }
 
 	if (conf.stylus_cone) {
+		trace::Scope scope {trace::Stage::cones};
+		std::lock_guard<std::mutex> lock {cones_mutex};
+
 		// Update touch rejection cones
 		for (int i = 0; i < count; i++) {
 			if (!inputs[i].palm)
@@ -247,6 +293,13 @@ void TouchManager::track(UInt8 &touch_cnt)
     }
 }
 
+void TouchManager::add_cone(std::shared_ptr<Cone> cone)
+{
+	std::lock_guard<std::mutex> lock {cones_mutex};
+
+	cones.push_back(std::move(cone));
+}
+
 void TouchManager::update_cones(const TouchInput &palm)
 {
 	std::shared_ptr<Cone> cone {nullptr};
@@ -261,7 +314,7 @@ void TouchManager::update_cones(const TouchInput &palm)
 		if (!current->active())
 			continue;
 
-		Float64 current_d = std::hypot(current->x - palm.x, current->y - palm.y);
+		Float64 current_d = current->distance_to(palm.x, palm.y);
 		if (current_d < d) {
 			d = current_d;
 			cone = current;
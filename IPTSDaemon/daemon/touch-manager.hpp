@@ -5,12 +5,14 @@
 
 #include "cone.hpp"
 #include "config.hpp"
+#include "normalizer.hpp"
 
 #include <common/types.hpp>
 #include <contacts/processor.hpp>
 #include <container/image.hpp>
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace iptsd::daemon {
@@ -58,7 +60,14 @@ public:
 
 	std::vector<TouchInput> &process(const Heatmap &data);
 
+	// Styli are discovered by the stylus processing, which may run on another thread
+	void add_cone(std::shared_ptr<Cone> cone);
+
 private:
+	Normalizer normalize;
+	std::mutex cones_mutex;
+
+	bool is_active(const Heatmap &data) const;
 	void track(UInt8 &touch_cnt);
 	void update_cones(const TouchInput &palm);
 	bool check_cones(const TouchInput &input);
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "trace.hpp"
+
+#include <common/cerror.hpp>
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <fmt/format.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace iptsd::daemon::trace {
+
+static std::atomic<UInt8> n_threads {0};
+static std::array<std::atomic<const char *>, 256> names {};
+
+const char *name(Stage stage)
+{
+	switch (stage) {
+	case Stage::receive:
+		return "receive";
+	case Stage::parse:
+		return "parse";
+	case Stage::touch:
+		return "touch";
+	case Stage::contacts:
+		return "contacts";
+	case Stage::tracking:
+		return "tracking";
+	case Stage::cones:
+		return "cones";
+	case Stage::report:
+		return "report";
+	case Stage::stylus:
+		return "stylus";
+	case Stage::send:
+		return "send";
+	}
+
+	return "unknown";
+}
+
+Log &global()
+{
+	static Log log {};
+	return log;
+}
+
+void thread(const char *name)
+{
+	// 0 is left for the threads that have no name, numbers are only reused after 255 threads
+	UInt8 id = n_threads.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (id == 0)
+		id = n_threads.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	names[id].store(name, std::memory_order_relaxed);
+	current.thread = id;
+}
+
+void Log::record(const Span &span)
+{
+	const UInt64 pos = next.fetch_add(1, std::memory_order_relaxed);
+	Slot &slot = slots[pos % capacity];
+
+	// odd while writing, so that readers can tell a complete span from a torn one
+	slot.sequence.store(2 * pos + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const UInt64 info = static_cast<UInt64>(span.timestamp) |
+			    static_cast<UInt64>(span.stage) << 32 |
+			    static_cast<UInt64>(span.thread) << 40;
+
+	slot.words[0].store(span.frame, std::memory_order_relaxed);
+	slot.words[1].store(span.begin, std::memory_order_relaxed);
+	slot.words[2].store(span.end, std::memory_order_relaxed);
+	slot.words[3].store(info, std::memory_order_relaxed);
+
+	slot.sequence.store(2 * pos + 2, std::memory_order_release);
+}
+
+std::vector<Span> Log::snapshot() const
+{
+	const UInt64 end = next.load(std::memory_order_acquire);
+	const UInt64 begin = end > capacity ? end - capacity : 0;
+
+	std::vector<Span> spans {};
+	spans.reserve(end - begin);
+
+	for (UInt64 pos = begin; pos < end; pos++) {
+		const Slot &slot = slots[pos % capacity];
+
+		// still being written, or already overwritten by a newer span
+		const UInt64 sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != 2 * pos + 2)
+			continue;
+
+		Span span {};
+		span.frame = slot.words[0].load(std::memory_order_relaxed);
+		span.begin = slot.words[1].load(std::memory_order_relaxed);
+		span.end = slot.words[2].load(std::memory_order_relaxed);
+
+		const UInt64 info = slot.words[3].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+
+		span.timestamp = static_cast<UInt32>(info);
+		span.stage = static_cast<Stage>((info >> 32) & 0xFF);
+		span.thread = static_cast<UInt8>(info >> 40);
+
+		spans.push_back(span);
+	}
+
+	return spans;
+}
+
+std::size_t dump(const std::string &path)
+{
+	std::vector<Span> spans = global().snapshot();
+
+	std::sort(spans.begin(), spans.end(),
+		  [](const Span &a, const Span &b) { return a.begin < b.begin; });
+
+	/*
+	 * The daemon runs as root, so the file is never opened by its name, which could be a
+	 * symlink planted by someone else. Instead a new file is created exclusively next to
+	 * it, and renamed over it once it is complete.
+	 */
+	std::string tmp = path + ".XXXXXX";
+
+	const int fd = mkstemp(tmp.data());
+	if (fd == -1)
+		throw common::cerror("Failed to create a file next to " + path);
+
+	std::FILE *file = fdopen(fd, "w");
+	if (!file) {
+		auto e = common::cerror("Failed to open " + tmp);
+		close(fd);
+		unlink(tmp.c_str());
+		throw e;
+	}
+
+	const UInt64 origin = spans.empty() ? 0 : spans.front().begin;
+
+	fmt::print(file, "frame,timestamp,thread,stage,begin_us,duration_us\n");
+
+	for (const Span &span : spans) {
+		const char *thread = names[span.thread].load(std::memory_order_relaxed);
+
+		fmt::print(file, "{},{},{},{},{:.3f},{:.3f}\n", span.frame, span.timestamp,
+			   thread ? std::string(thread) : std::to_string(span.thread), name(span.stage),
+			   static_cast<Float64>(span.begin - origin) / 1000,
+			   static_cast<Float64>(span.end - span.begin) / 1000);
+	}
+
+	if (std::fclose(file) != 0 || std::rename(tmp.c_str(), path.c_str()) != 0) {
+		auto e = common::cerror("Failed to write " + path);
+		unlink(tmp.c_str());
+		throw e;
+	}
+
+	return spans.size();
+}
+
+} // namespace iptsd::daemon::trace
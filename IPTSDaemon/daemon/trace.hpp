@@ -0,0 +1,179 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_DAEMON_TRACE_HPP
+#define IPTSD_DAEMON_TRACE_HPP
+
+#include <common/types.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Per-frame latency tracing, from the moment a buffer is received until its HID reports have
+ * been sent.
+ *
+ * Every stage that a buffer passes records a span with its begin and end time into a global
+ * ring that always holds the most recent spans, so that the history around a latency spike
+ * can be dumped after the fact (see dump()). The spans of a buffer share the number of the
+ * buffer (its frame) and the timestamp that the sensor attached to the data.
+ *
+ * The frame and the sensor timestamp are kept per thread in the current context, so that
+ * the code in between does not need to pass them around. Recording a span takes two clock
+ * reads and a few atomic stores, and nothing at all if tracing is disabled.
+ */
+namespace iptsd::daemon::trace {
+
+enum class Stage : UInt8 {
+	receive,  // handing a received buffer to the processing threads
+	parse,    // parsing a buffer, including the processing of everything in it
+	touch,    // processing a heatmap into a touch report
+	contacts, // finding the contacts in a heatmap
+	tracking, // matching the contacts to the ones of the previous heatmap
+	cones,    // palm rejection around the stylus
+	report,   // building the touch report
+	stylus,   // processing the stylus data into a stylus report
+	send,     // passing a report to the driver
+};
+
+const char *name(Stage stage);
+
+struct Span {
+	UInt64 frame = 0;
+	UInt32 timestamp = 0;
+	Stage stage = Stage::receive;
+	UInt8 thread = 0;
+
+	// nanoseconds of a monotonic clock
+	UInt64 begin = 0;
+	UInt64 end = 0;
+};
+
+/*
+ * A fixed number of spans, where new spans overwrite the oldest ones. Any thread can record
+ * spans and take a snapshot at the same time without locking.
+ *
+ * Each slot is a sequence lock: a writer marks the slot as busy, writes the span and marks it
+ * as complete with the position it was written for. A reader only keeps a span if the mark
+ * was the same before and after reading it. The span is stored as atomic words, so that a
+ * torn read is well-defined, it is just thrown away.
+ */
+class Log {
+public:
+	static constexpr std::size_t capacity = 1 << 14;
+
+	void record(const Span &span);
+
+	/*
+	 * The spans that are in the log, oldest first. Spans that are being written while the
+	 * snapshot is taken are left out.
+	 */
+	[[nodiscard]] std::vector<Span> snapshot() const;
+
+private:
+	struct Slot {
+		std::atomic<UInt64> sequence {0};
+		std::array<std::atomic<UInt64>, 4> words {};
+	};
+
+	std::atomic<UInt64> next {0};
+	std::array<Slot, capacity> slots {};
+};
+
+/*
+ * What the current thread is working on.
+ */
+struct Context {
+	UInt64 frame = 0;
+	UInt32 timestamp = 0;
+	UInt8 thread = 0;
+};
+
+inline std::atomic_bool enabled {false};
+inline thread_local Context current {};
+
+Log &global();
+
+inline UInt64 now()
+{
+	auto const t = std::chrono::steady_clock::now().time_since_epoch();
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+}
+
+/*
+ * Numbers and names the current thread for the dumps. The spans of threads that never call
+ * this are dumped as thread 0.
+ */
+void thread(const char *name);
+
+/*
+ * Starts a new frame on the current thread. The sensor timestamp is not known until the
+ * buffer has been parsed.
+ */
+inline void frame(UInt64 frame, UInt32 timestamp = 0)
+{
+	current.frame = frame;
+	current.timestamp = timestamp;
+}
+
+inline void timestamp(UInt32 timestamp)
+{
+	current.timestamp = timestamp;
+}
+
+/*
+ * Records the time between its construction and stop() or its destruction as a span of the
+ * current frame.
+ */
+class Scope {
+public:
+	explicit Scope(Stage stage);
+	~Scope();
+
+	Scope(const Scope &) = delete;
+	Scope &operator=(const Scope &) = delete;
+
+	void stop();
+
+private:
+	Stage stage;
+	UInt64 begin = 0;
+	bool active;
+};
+
+inline Scope::Scope(Stage stage) : stage(stage), active(enabled.load(std::memory_order_relaxed))
+{
+	if (active)
+		begin = now();
+}
+
+inline Scope::~Scope()
+{
+	stop();
+}
+
+inline void Scope::stop()
+{
+	if (!active)
+		return;
+
+	active = false;
+	const Span span {current.frame, current.timestamp, stage, current.thread, begin, now()};
+	global().record(span);
+}
+
+/*
+ * Writes a snapshot of the log to a CSV file, one span per line, with the times in
+ * microseconds relative to the oldest span. Returns the number of spans. The file is
+ * replaced, never written through an existing file or symlink, and only readable by its
+ * owner.
+ */
+std::size_t dump(const std::string &path);
+
+} /* namespace iptsd::daemon::trace */
+
+#endif /* IPTSD_DAEMON_TRACE_HPP */
@@ -0,0 +1,907 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Runs the touch processors over the heatmaps of one or more captures written by dump.cpp and
+ * prints the statistics of the performance registry as JSON. Does not need IOKit, so it can be
+ * built on any machine with:
+ *
+ *   cd IPTSDaemon && c++ -std=gnu++17 -O2 -I . -o iptsd-perf debug/perf.cpp daemon/parser.cpp \
+ *       contacts/advanced/processor.cpp contacts/basic/cluster.cpp contacts/basic/heatmap.cpp \
+ *       contacts/basic/processor.cpp -lfmt -lspdlog
+ *
+ * Add -DIPTSD_CONFIG_WDT_BINARY_HEAP to run the distance transform on a binary heap instead
+ * of the bucket queue, for comparison.
+ *
+ * With --conv <width>x<height> the convolutions are timed on random images instead, once for
+ * every instruction set supported by the machine, together with the largest deviation from
+ * the scalar code.
+ *
+ * With --math the functions of math/fast.hpp are timed on random inputs, together with their
+ * largest error relative to the standard library. With --check-math the captures are replayed
+ * through the advanced processor with and without the approximations, and the largest
+ * distance between the contact positions is compared against --tolerance (in pixels).
+ * --approx enables the approximations for the normal statistics, like ApproxMath in the config
+ * of the daemon.
+ *
+ * With --check-gfit the systems of the Gaussian fit are assembled for random contacts, from the
+ * moments and entry by entry, and their largest relative difference is compared against
+ * --tolerance (1e-9 by default). With --solve these systems are solved through the LDL^T
+ * decomposition and through Gaussian elimination, and both are timed.
+ *
+ * With --normalize the conversion of the raw heatmaps of the captures to Float32 is timed,
+ * directly and through the lookup table of the daemon.
+ *
+ * With --trace <file> every measurement of the normal statistics is also written to a file in
+ * the Chrome trace event format, numbered by the heatmap it belongs to.
+ */
+
+#include <common/simd.hpp>
+#include <common/types.hpp>
+#include <contacts/advanced/algorithm/convolution.hpp>
+#include <contacts/advanced/algorithm/gaussian_fitting.hpp>
+#include <contacts/advanced/processor.hpp>
+#include <contacts/basic/processor.hpp>
+#include <contacts/eval/perf.hpp>
+#include <contacts/interface.hpp>
+#include <container/arena.hpp>
+#include <container/image.hpp>
+#include <daemon/normalizer.hpp>
+#include <daemon/parser.hpp>
+#include <math/fast.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace iptsd::contacts;
+
+namespace iptsd::debug::perf {
+
+static void usage()
+{
+	fmt::print(stderr, "Usage: iptsd-perf [--processor basic|advanced|both] [--runs <n>] "
+			   "[--pressure <value>] [--approx] [--trace <file>] <capture>...\n");
+	fmt::print(stderr, "       iptsd-perf --check-math [--tolerance <pixels>] <capture>...\n");
+	fmt::print(stderr, "       iptsd-perf --normalize [--runs <n>] <capture>...\n");
+	fmt::print(stderr, "       iptsd-perf --conv <width>x<height> [--runs <n>]\n");
+	fmt::print(stderr, "       iptsd-perf --math [--runs <n>]\n");
+	fmt::print(stderr, "       iptsd-perf --check-gfit [--tolerance <relative>]\n");
+	fmt::print(stderr, "       iptsd-perf --solve [--runs <n>]\n");
+}
+
+static std::string escape(const std::string &str)
+{
+	std::string out;
+
+	for (char c : str) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+
+		out += c;
+	}
+
+	return out;
+}
+
+/*
+ * A heatmap as it was read from the device, before the conversion to Float32.
+ */
+struct RawHeatmap {
+	index2_t size;
+	UInt8 z_min;
+	UInt8 z_max;
+	std::vector<UInt8> data;
+};
+
+static void load(const std::string &path, std::vector<RawHeatmap> &heatmaps)
+{
+	std::ifstream file;
+	file.exceptions(std::ios::badbit | std::ios::failbit);
+	file.open(path, std::ios::in | std::ios::binary);
+
+	std::vector<UInt8> buffer {std::istreambuf_iterator<char>(file), {}};
+	gsl::span<UInt8> data {buffer};
+
+	daemon::Parser parser;
+	parser.on_heatmap = [&](const auto &data) {
+		heatmaps.push_back(RawHeatmap {index2_t {data.width, data.height}, data.z_min,
+					       data.z_max, {data.data.begin(), data.data.end()}});
+	};
+
+	parser.prepare(&data);
+
+	try {
+		parser.parse_loop();
+	} catch (std::out_of_range &e) {
+		spdlog::warn("{}: Stopped parsing at a malformed buffer", path);
+	}
+}
+
+static void load(const std::string &path, std::vector<container::Image<Float32>> &heatmaps)
+{
+	std::vector<RawHeatmap> raw;
+	load(path, raw);
+
+	daemon::Normalizer normalize;
+
+	for (const auto &r : raw) {
+		container::Image<Float32> hm {r.size};
+
+		normalize(r.data, r.z_min, r.z_max, hm.data());
+		heatmaps.push_back(std::move(hm));
+	}
+}
+
+static void run(ITouchProcessor &proc, const std::vector<container::Image<Float32>> &heatmaps,
+		int runs, eval::perf::TraceSink *trace)
+{
+	UInt64 frame = 0;
+
+	for (int i = 0; i < runs; i++) {
+		for (const auto &hm : heatmaps) {
+			if (trace)
+				trace->frame(frame++);
+
+			std::copy(hm.begin(), hm.end(), proc.hm().begin());
+			proc.process();
+		}
+	}
+}
+
+static void print(const std::string &name, index2_t size, int runs, size_t frames,
+		  const eval::perf::Registry &reg, const container::Arena *scratch, bool last)
+{
+	using ns = std::chrono::nanoseconds;
+
+	fmt::print("    {{\n");
+	fmt::print("      \"processor\": \"{}\",\n", name);
+	fmt::print("      \"size\": [{}, {}],\n", size.x, size.y);
+	fmt::print("      \"runs\": {},\n", runs);
+	fmt::print("      \"frames\": {},\n", frames);
+
+	if (scratch) {
+		fmt::print("      \"scratch\": {{ \"size\": {}, \"requested\": {} }},\n",
+			   scratch->size(), scratch->requested());
+	}
+
+	fmt::print("      \"stages\": [\n");
+
+	auto const &entries = reg.entries();
+	for (auto it = entries.begin(); it != entries.end(); it++) {
+		fmt::print("        {{ \"name\": \"{}\", \"n\": {}, \"total_ns\": {}, \"mean_ns\": {}, "
+			   "\"stddev_ns\": {}, \"min_ns\": {}, \"max_ns\": {}, \"p50_ns\": {}, "
+			   "\"p90_ns\": {}, \"p99_ns\": {}, \"p999_ns\": {} }}{}\n",
+			   escape(it->name), it->n_measurements, it->total<ns>().count(),
+			   it->mean<ns>().count(), it->stddev<ns>().count(),
+			   it->n_measurements ? it->min<ns>().count() : 0, it->max<ns>().count(),
+			   it->percentile<ns>(50).count(), it->percentile<ns>(90).count(),
+			   it->percentile<ns>(99).count(), it->percentile<ns>(99.9).count(),
+			   std::next(it) != entries.end() ? "," : "");
+	}
+
+	fmt::print("      ],\n");
+	fmt::print("      \"counters\": [\n");
+
+	auto const &counters = reg.counters();
+	for (auto it = counters.begin(); it != counters.end(); it++) {
+		fmt::print("        {{ \"name\": \"{}\", \"n\": {}, \"mean\": {}, \"min\": {}, "
+			   "\"max\": {} }}{}\n",
+			   escape(it->name), it->n_samples, it->mean(), it->minimum, it->maximum,
+			   std::next(it) != counters.end() ? "," : "");
+	}
+
+	fmt::print("      ]\n");
+	fmt::print("    }}{}\n", last ? "" : ",");
+}
+
+static Float32 deviation(Float32 a, Float32 b)
+{
+	return std::abs(a - b);
+}
+
+static Float32 deviation(const math::Mat2s<Float32> &a, const math::Mat2s<Float32> &b)
+{
+	return std::max({std::abs(a.xx - b.xx), std::abs(a.xy - b.xy), std::abs(a.yy - b.yy)});
+}
+
+template <class T, class K>
+static void bench_conv(const std::string &name, const container::Image<T> &in, const K &kernel,
+		       int runs, bool last)
+{
+	using namespace advanced::alg;
+	using ns = std::chrono::nanoseconds;
+
+	std::vector<common::simd::Isa> isas {common::simd::Isa::scalar};
+	if (common::simd::detect() == common::simd::Isa::avx2)
+		isas.push_back(common::simd::Isa::sse2);
+	if (common::simd::detect() != common::simd::Isa::scalar)
+		isas.push_back(common::simd::detect());
+
+	container::Image<T> ref {in.size()};
+	container::Image<T> out {in.size()};
+
+	fmt::print("    {{ \"name\": \"{}\", \"isa\": [\n", name);
+
+	for (size_t i = 0; i < isas.size(); i++) {
+		common::simd::force(isas[i]);
+
+		auto const start = eval::perf::clock::now();
+		for (int r = 0; r < runs; r++)
+			convolve(out, in, kernel);
+		auto const elapsed = eval::perf::clock::now() - start;
+
+		if (i == 0)
+			std::copy(out.begin(), out.end(), ref.begin());
+
+		Float32 dev = 0.0f;
+		for (index_t j = 0; j < out.size().span(); j++)
+			dev = std::max(dev, deviation(out[j], ref[j]));
+
+		fmt::print("      {{ \"name\": \"{}\", \"mean_ns\": {}, \"max_deviation\": {} }}{}\n",
+			   common::simd::name(isas[i]), std::chrono::duration_cast<ns>(elapsed).count() / runs,
+			   dev, i + 1 < isas.size() ? "," : "");
+	}
+
+	fmt::print("    ] }}{}\n", last ? "" : ",");
+	common::simd::force(common::simd::detect());
+}
+
+static int bench_conv(index2_t size, int runs)
+{
+	using namespace advanced::alg;
+
+	std::mt19937 rng {42};
+	std::uniform_real_distribution<Float32> dist {0.0f, 1.0f};
+
+	container::Image<Float32> hm {size};
+	container::Image<math::Mat2s<Float32>> st {size};
+
+	std::generate(hm.begin(), hm.end(), [&]() { return dist(rng); });
+	std::generate(st.begin(), st.end(), [&]() {
+		return math::Mat2s<Float32> {dist(rng), dist(rng), dist(rng)};
+	});
+
+	auto const k5 = conv::kernels::gaussian<Float32, 5, 5>(1.0f);
+	auto const ks = conv::kernels::gaussian_separable<Float32, 5, 5>(1.0f);
+
+	fmt::print("{{\n");
+	fmt::print("  \"size\": [{}, {}],\n", size.x, size.y);
+	fmt::print("  \"runs\": {},\n", runs);
+	fmt::print("  \"convolutions\": [\n");
+
+	bench_conv("gaussian-5x5/f32", hm, k5, runs, false);
+	bench_conv("gaussian-5x5/mat2s", st, k5, runs, false);
+	bench_conv("gaussian-separable/f32", hm, ks, runs, false);
+	bench_conv("gaussian-separable/mat2s", st, ks, runs, false);
+	bench_conv("sobel-3x3/f32", hm, conv::kernels::sobel3_x<Float32>, runs, true);
+
+	fmt::print("  ]\n");
+	fmt::print("}}\n");
+
+	return 0;
+}
+
+/*
+ * Times f and g over the inputs and returns the mean time per call of each, and the largest
+ * error of g relative to f. The error is absolute where |f| <= 1.
+ */
+template <class T, class F, class G>
+static void bench_math(const std::string &name, const std::vector<std::array<T, 2>> &in, F f, G g,
+		       int runs, bool last)
+{
+	using ns = std::chrono::nanoseconds;
+
+	std::vector<T> ref(in.size());
+	std::vector<T> out(in.size());
+
+	auto const time = [&](auto fn, std::vector<T> &res) {
+		auto const start = eval::perf::clock::now();
+
+		for (int r = 0; r < runs; r++) {
+			std::transform(in.begin(), in.end(), res.begin(),
+				       [&](auto const &v) { return fn(v[0], v[1]); });
+		}
+
+		auto const elapsed = eval::perf::clock::now() - start;
+		auto const calls = static_cast<Float64>(runs) * static_cast<Float64>(in.size());
+
+		return static_cast<Float64>(std::chrono::duration_cast<ns>(elapsed).count()) / calls;
+	};
+
+	auto const t_std = time(f, ref);
+	auto const t_approx = time(g, out);
+
+	Float64 err = 0;
+	for (size_t i = 0; i < in.size(); i++) {
+		auto const r = static_cast<Float64>(ref[i]);
+		auto const d = std::abs(static_cast<Float64>(out[i]) - r);
+
+		err = std::max(err, d / std::max(std::abs(r), 1.0));
+	}
+
+	fmt::print("    {{ \"name\": \"{}\", \"std_ns\": {:.2f}, \"approx_ns\": {:.2f}, "
+		   "\"max_error\": {:.3g} }}{}\n",
+		   name, t_std, t_approx, err, last ? "" : ",");
+}
+
+template <class T> static void bench_math(const std::string &type, int runs, bool last)
+{
+	namespace fast = math::fast;
+
+	std::mt19937 rng {42};
+
+	// inputs in the ranges that occur in the processor, and beyond
+	auto const inputs = [&](T lo, T hi) {
+		std::uniform_real_distribution<T> dist {lo, hi};
+		std::vector<std::array<T, 2>> v(4096);
+
+		std::generate(v.begin(), v.end(), [&]() { return std::array<T, 2> {dist(rng), dist(rng)}; });
+		return v;
+	};
+
+	auto const exp_in = inputs(-80, 80);
+	auto const exp_uf_in = inputs(-1e4, -100);
+	auto const log_in = inputs(1e-6, 1e6);
+	auto const pow_in = inputs(1e-3, 10);
+	auto const sqrt_in = inputs(0, 1e3);
+	auto const atan2_in = inputs(-1, 1);
+
+	bench_math(
+		"exp/" + type, exp_in, [](T x, T) { return fast::Std::exp(x); },
+		[](T x, T) { return fast::Approx::exp(x); }, runs, false);
+	bench_math(
+		"exp-underflow/" + type, exp_uf_in, [](T x, T) { return fast::Std::exp(x); },
+		[](T x, T) { return fast::Approx::exp(x); }, runs, false);
+	bench_math(
+		"log/" + type, log_in, [](T x, T) { return fast::Std::log(x); },
+		[](T x, T) { return fast::Approx::log(x); }, runs, false);
+	bench_math(
+		"pow/" + type, pow_in, [](T x, T y) { return fast::Std::pow(x, -y); },
+		[](T x, T y) { return fast::Approx::pow(x, -y); }, runs, false);
+	bench_math(
+		"sqrt/" + type, sqrt_in, [](T x, T) { return fast::Std::sqrt(x); },
+		[](T x, T) { return fast::Approx::sqrt(x); }, runs, false);
+	bench_math(
+		"atan2/" + type, atan2_in, [](T y, T x) { return fast::Std::atan2(y, x); },
+		[](T y, T x) { return fast::Approx::atan2(y, x); }, runs, last);
+}
+
+static int bench_math(int runs)
+{
+	fmt::print("{{\n");
+	fmt::print("  \"runs\": {},\n", runs);
+	fmt::print("  \"functions\": [\n");
+
+	bench_math<Float32>("f32", runs, false);
+	bench_math<Float64>("f64", runs, true);
+
+	fmt::print("  ]\n");
+	fmt::print("}}\n");
+
+	return 0;
+}
+
+/*
+ * Times the conversion of the raw heatmaps to Float32, directly and through the lookup table
+ * of daemon::Normalizer with every instruction set supported by the machine, together with the
+ * number of values that differ from the direct conversion.
+ */
+static int bench_normalize(const std::vector<RawHeatmap> &heatmaps, int runs)
+{
+	using ns = std::chrono::nanoseconds;
+
+	size_t pixels = 0;
+	for (const auto &hm : heatmaps)
+		pixels = std::max(pixels, hm.data.size());
+
+	std::vector<Float32> ref(pixels);
+	std::vector<Float32> out(pixels);
+
+	auto const frames = static_cast<Float64>(runs) * static_cast<Float64>(heatmaps.size());
+
+	auto const time = [&](auto fn) {
+		auto const start = eval::perf::clock::now();
+
+		for (int r = 0; r < runs; r++) {
+			for (const auto &hm : heatmaps)
+				fn(hm);
+		}
+
+		auto const elapsed = eval::perf::clock::now() - start;
+		return static_cast<Float64>(std::chrono::duration_cast<ns>(elapsed).count()) / frames;
+	};
+
+	auto const t_div = time([&](const RawHeatmap &hm) {
+		std::transform(hm.data.begin(), hm.data.end(), ref.begin(), [&](auto v) {
+			Float32 val = static_cast<Float32>(v - hm.z_min) /
+				      static_cast<Float32>(hm.z_max - hm.z_min);
+
+			return 1.0f - val;
+		});
+	});
+
+	std::vector<common::simd::Isa> isas {common::simd::Isa::scalar};
+	if (common::simd::detect() == common::simd::Isa::avx2)
+		isas.push_back(common::simd::Isa::avx2);
+
+	fmt::print("{{\n");
+	fmt::print("  \"runs\": {},\n", runs);
+	fmt::print("  \"frames\": {},\n", heatmaps.size());
+	fmt::print("  \"division_ns\": {:.1f},\n", t_div);
+	fmt::print("  \"table\": [\n");
+
+	for (size_t i = 0; i < isas.size(); i++) {
+		common::simd::force(isas[i]);
+		daemon::Normalizer normalize;
+
+		auto const t_lut = time([&](const RawHeatmap &hm) {
+			normalize(hm.data, hm.z_min, hm.z_max, out.data());
+		});
+
+		// compares the bits, so that NaN from an empty range counts as identical
+		size_t mismatches = 0;
+		for (const auto &hm : heatmaps) {
+			normalize(hm.data, hm.z_min, hm.z_max, out.data());
+
+			for (size_t j = 0; j < hm.data.size(); j++) {
+				auto const r = daemon::Normalizer::convert(hm.data[j], hm.z_min, hm.z_max);
+				mismatches += std::memcmp(&r, &out[j], sizeof(Float32)) != 0;
+			}
+		}
+
+		fmt::print("    {{ \"name\": \"{}\", \"mean_ns\": {:.1f}, \"mismatches\": {} }}{}\n",
+			   common::simd::name(isas[i]), t_lut, mismatches,
+			   i + 1 < isas.size() ? "," : "");
+	}
+
+	fmt::print("  ]\n");
+	fmt::print("}}\n");
+
+	common::simd::force(common::simd::detect());
+	return 0;
+}
+
+/*
+ * Replays the heatmaps through the advanced processor with and without the approximations of
+ * math/fast.hpp and compares the contacts of every frame. Fails if the number of contacts
+ * differs or a contact moved by more than the tolerance (in pixels).
+ */
+static int check_math(const std::vector<container::Image<Float32>> &heatmaps, Float32 tolerance)
+{
+	auto const size = heatmaps[0].size();
+
+	advanced::TouchProcessor precise {size, false};
+	advanced::TouchProcessor approx {size, true};
+
+	size_t frames = 0;
+	size_t contacts = 0;
+	size_t mismatches = 0;
+	Float32 dev_pos = 0;
+	Float32 dev_conf = 0;
+
+	for (const auto &hm : heatmaps) {
+		std::copy(hm.begin(), hm.end(), precise.hm().begin());
+		std::copy(hm.begin(), hm.end(), approx.hm().begin());
+
+		auto const &a = precise.process();
+		auto const &b = approx.process();
+
+		frames++;
+
+		if (a.size() != b.size()) {
+			mismatches++;
+			continue;
+		}
+
+		for (size_t i = 0; i < a.size(); i++) {
+			auto const dx = (a[i].mean.x - b[i].mean.x) * static_cast<Float32>(size.x);
+			auto const dy = (a[i].mean.y - b[i].mean.y) * static_cast<Float32>(size.y);
+
+			dev_pos = std::max(dev_pos, std::hypot(dx, dy));
+			dev_conf = std::max(dev_conf, std::abs(a[i].confidence - b[i].confidence));
+			contacts++;
+		}
+	}
+
+	bool const ok = mismatches == 0 && dev_pos <= tolerance;
+
+	fmt::print("{{\n");
+	fmt::print("  \"frames\": {},\n", frames);
+	fmt::print("  \"contacts\": {},\n", contacts);
+	fmt::print("  \"count_mismatches\": {},\n", mismatches);
+	fmt::print("  \"max_position_deviation_px\": {:.3g},\n", dev_pos);
+	fmt::print("  \"max_confidence_deviation\": {:.3g},\n", dev_conf);
+	fmt::print("  \"tolerance_px\": {},\n", tolerance);
+	fmt::print("  \"ok\": {}\n", ok);
+	fmt::print("}}\n");
+
+	return ok ? 0 : EXIT_FAILURE;
+}
+
+/*
+ * Draws a contact at a random position of the heatmap and fills the window around it, clamped
+ * like in the advanced processor, with a random Gaussian plus noise. The weights are a Gaussian
+ * of a slightly different shape, like the fit sees them before it has converged.
+ */
+static advanced::alg::gfit::BBox random_contact(std::mt19937 &rng, container::Image<Float32> &hm,
+						container::Image<Float64> &weights)
+{
+	std::uniform_real_distribution<Float64> unit {0.0, 1.0};
+
+	auto const size = hm.size();
+	auto const window = weights.size();
+
+	math::Vec2<Float64> const mean {unit(rng) * (size.x - 1), unit(rng) * (size.y - 1)};
+	auto const x = static_cast<index_t>(std::lround(mean.x));
+	auto const y = static_cast<index_t>(std::lround(mean.y));
+
+	advanced::alg::gfit::BBox const b {
+		std::max(x - (window.x - 1) / 2, 0),
+		std::min(x + (window.x - 1) / 2, size.x - 1),
+		std::max(y - (window.y - 1) / 2, 0),
+		std::min(y + (window.y - 1) / 2, size.y - 1),
+	};
+
+	// standard deviations of 1 to 3 pixels and a correlation of at most 0.5
+	auto const sx = 1.0 + 2.0 * unit(rng);
+	auto const sy = 1.0 + 2.0 * unit(rng);
+	auto const rho = unit(rng) - 0.5;
+	math::Mat2s<Float64> const prec {1.0 / (sx * sx), rho / (sx * sy), 1.0 / (sy * sy)};
+
+	math::Vec2<Float64> const wmean {mean.x + unit(rng) - 0.5, mean.y + unit(rng) - 0.5};
+	auto const wprec = prec * (0.5 + 1.5 * unit(rng));
+	auto const scale = 0.3 + 0.7 * unit(rng);
+
+	for (index_t iy = b.ymin; iy <= b.ymax; iy++) {
+		for (index_t ix = b.xmin; ix <= b.xmax; ix++) {
+			math::Vec2<Float64> const p {static_cast<Float64>(ix), static_cast<Float64>(iy)};
+
+			auto const v = scale * std::exp(-prec.vtmv(p - mean) / 2) + 0.02 * unit(rng);
+
+			hm[{ix, iy}] = static_cast<Float32>(v);
+			weights[{ix - b.xmin, iy - b.ymin}] = std::exp(-wprec.vtmv(p - wmean) / 2);
+		}
+	}
+
+	return b;
+}
+
+/*
+ * Assembles the systems of the Gaussian fit for random contacts, once from the moments like
+ * the processor does and once entry by entry, and compares them. The difference of each entry
+ * is taken relative to the largest entry of the matrix or right-hand side, as the moments of
+ * odd powers may cancel out to almost zero. Fails if it exceeds the tolerance.
+ */
+static int check_gfit(int contacts, Float64 tolerance)
+{
+	using namespace advanced::alg;
+	using M = math::fast::Std;
+
+	index2_t const size {64, 44};
+
+	std::mt19937 rng {42};
+
+	container::Image<Float32> hm {size};
+	container::Image<Float64> weights {{11, 11}};
+	gfit::Grid<Float64> const grid {size};
+
+	Float64 dev_sys = 0;
+	Float64 dev_rhs = 0;
+
+	auto const deviation = [](auto const &a, auto const &b) {
+		Float64 dev = 0;
+		Float64 max = 0;
+
+		for (size_t i = 0; i < a.data.size(); i++) {
+			dev = std::max(dev, std::abs(a.data[i] - b.data[i]));
+			max = std::max(max, std::abs(b.data[i]));
+		}
+
+		return max > 0 ? dev / max : dev;
+	};
+
+	for (int i = 0; i < contacts; i++) {
+		auto const b = random_contact(rng, hm, weights);
+		auto const w = std::as_const(weights).view();
+
+		math::Mat6<Float64> sys {};
+		math::Vec6<Float64> rhs {};
+		math::Mat6<Float64> sys_ref {};
+		math::Vec6<Float64> rhs_ref {};
+
+		gfit::impl::assemble_system<M>(sys, rhs, b, hm, w, grid);
+		gfit::impl::assemble_system_direct<M>(sys_ref, rhs_ref, b, hm, w, grid);
+
+		dev_sys = std::max(dev_sys, deviation(sys, sys_ref));
+		dev_rhs = std::max(dev_rhs, deviation(rhs, rhs_ref));
+	}
+
+	bool const ok = dev_sys <= tolerance && dev_rhs <= tolerance;
+
+	fmt::print("{{\n");
+	fmt::print("  \"contacts\": {},\n", contacts);
+	fmt::print("  \"max_relative_deviation_matrix\": {:.3g},\n", dev_sys);
+	fmt::print("  \"max_relative_deviation_rhs\": {:.3g},\n", dev_rhs);
+	fmt::print("  \"tolerance\": {},\n", tolerance);
+	fmt::print("  \"ok\": {}\n", ok);
+	fmt::print("}}\n");
+
+	return ok ? 0 : EXIT_FAILURE;
+}
+
+/*
+ * Times the solvers of math/sle6.hpp on the systems of the Gaussian fit, assembled for random
+ * contacts. Reports the time per contact, the largest difference of the LDL^T solution from the
+ * one of Gaussian elimination, relative to its largest coefficient, and how many systems could
+ * not be factorized without pivoting, i.e. where ldlt_solve() falls back to Gaussian elimination.
+ */
+static int bench_solve(int contacts, int runs)
+{
+	using namespace advanced::alg;
+	using ns = std::chrono::nanoseconds;
+
+	index2_t const size {64, 44};
+	auto const n = static_cast<size_t>(contacts);
+
+	std::mt19937 rng {42};
+
+	container::Image<Float32> hm {size};
+	container::Image<Float64> weights {{11, 11}};
+	gfit::Grid<Float64> const grid {size};
+
+	std::vector<math::Mat6<Float64>> sys(n);
+	std::vector<math::Vec6<Float64>> rhs(n);
+
+	for (size_t i = 0; i < n; i++) {
+		auto const b = random_contact(rng, hm, weights);
+		gfit::impl::assemble_system<math::fast::Std>(sys[i], rhs[i], b, hm,
+							     std::as_const(weights).view(), grid);
+	}
+
+	auto const time = [&](auto solve, std::vector<math::Vec6<Float64>> &res) {
+		auto const start = eval::perf::clock::now();
+
+		for (int r = 0; r < runs; r++) {
+			for (size_t i = 0; i < n; i++)
+				solve(sys[i], rhs[i], res[i]);
+		}
+
+		auto const elapsed = eval::perf::clock::now() - start;
+		auto const calls = static_cast<Float64>(runs) * static_cast<Float64>(n);
+
+		return static_cast<Float64>(std::chrono::duration_cast<ns>(elapsed).count()) / calls;
+	};
+
+	std::vector<math::Vec6<Float64>> x_ldlt(n);
+	std::vector<math::Vec6<Float64>> x_ge(n);
+
+	auto const t_ldlt = time(
+		[](auto const &a, auto const &b, auto &x) { math::ldlt_solve(a, b, x); }, x_ldlt);
+	auto const t_ge = time(
+		[](auto const &a, auto const &b, auto &x) { math::ge_solve(a, b, x); }, x_ge);
+
+	Float64 dev = 0;
+	size_t fallbacks = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		Float64 diff = 0;
+		Float64 max = 0;
+
+		for (size_t k = 0; k < 6; k++) {
+			diff = std::max(diff, std::abs(x_ldlt[i].data[k] - x_ge[i].data[k]));
+			max = std::max(max, std::abs(x_ge[i].data[k]));
+		}
+
+		dev = std::max(dev, max > 0 ? diff / max : diff);
+
+		math::Mat6<Float64> ld {};
+		fallbacks += !math::ldlt_decomp(sys[i], ld, math::ldlt_tol<Float64>);
+	}
+
+	fmt::print("{{\n");
+	fmt::print("  \"contacts\": {},\n", contacts);
+	fmt::print("  \"runs\": {},\n", runs);
+	fmt::print("  \"ldlt_ns\": {:.1f},\n", t_ldlt);
+	fmt::print("  \"ge_ns\": {:.1f},\n", t_ge);
+	fmt::print("  \"max_relative_deviation\": {:.3g},\n", dev);
+	fmt::print("  \"fallbacks\": {}\n", fallbacks);
+	fmt::print("}}\n");
+
+	return 0;
+}
+
+static int main(int argc, char *argv[])
+{
+	std::vector<std::string> paths;
+	bool basic = false;
+	bool advanced = true;
+	int runs = 10;
+	Float32 pressure = 0.04;
+	index2_t conv_size {0, 0};
+	bool math = false;
+	bool check = false;
+	bool check_fit = false;
+	bool solve = false;
+	bool approx = false;
+	bool normalize = false;
+	std::optional<Float64> tolerance;
+	std::string trace_path;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg {argv[i]};
+		bool has_value = i + 1 < argc;
+
+		if (arg == "--processor" && has_value) {
+			std::string value {argv[++i]};
+
+			basic = value == "basic" || value == "both";
+			advanced = value == "advanced" || value == "both";
+		} else if (arg == "--runs" && has_value) {
+			runs = std::stoi(argv[++i]);
+		} else if (arg == "--pressure" && has_value) {
+			pressure = std::stof(argv[++i]);
+		} else if (arg == "--math") {
+			math = true;
+		} else if (arg == "--check-math") {
+			check = true;
+		} else if (arg == "--check-gfit") {
+			check_fit = true;
+		} else if (arg == "--solve") {
+			solve = true;
+		} else if (arg == "--normalize") {
+			normalize = true;
+		} else if (arg == "--approx") {
+			approx = true;
+		} else if (arg == "--trace" && has_value) {
+			trace_path = argv[++i];
+		} else if (arg == "--tolerance" && has_value) {
+			tolerance = std::stod(argv[++i]);
+		} else if (arg == "--conv" && has_value) {
+			std::string value {argv[++i]};
+			auto const sep = value.find('x');
+
+			if (sep == std::string::npos) {
+				usage();
+				return EXIT_FAILURE;
+			}
+
+			conv_size.x = std::stoi(value.substr(0, sep));
+			conv_size.y = std::stoi(value.substr(sep + 1));
+		} else if (arg[0] != '-') {
+			paths.push_back(arg);
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (conv_size.x > 0 && conv_size.y > 0 && runs > 0)
+		return bench_conv(conv_size, runs);
+
+	if (math && runs > 0)
+		return bench_math(runs);
+
+	if (solve && runs > 0)
+		return bench_solve(1000, runs);
+
+	if (check_fit)
+		return check_gfit(1000, tolerance.value_or(1e-9));
+
+	if (paths.empty() || (!basic && !advanced) || runs < 1) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (normalize) {
+		std::vector<RawHeatmap> raw;
+		for (const auto &path : paths)
+			load(path, raw);
+
+		return bench_normalize(raw, runs);
+	}
+
+	std::vector<container::Image<Float32>> heatmaps;
+	for (const auto &path : paths)
+		load(path, heatmaps);
+
+	if (heatmaps.empty()) {
+		spdlog::warn("No touch data found!");
+		return EXIT_FAILURE;
+	}
+
+	// The processors are created for a fixed size, only keep what matches the first heatmap
+	index2_t size = heatmaps[0].size();
+	auto end = std::remove_if(heatmaps.begin(), heatmaps.end(),
+				  [&](const auto &hm) { return hm.size() != size; });
+
+	if (end != heatmaps.end()) {
+		spdlog::warn("Skipping {} heatmaps with a different size",
+			     std::distance(end, heatmaps.end()));
+		heatmaps.erase(end, heatmaps.end());
+	}
+
+	if (check)
+		return check_math(heatmaps, static_cast<Float32>(tolerance.value_or(0.01)));
+
+	fmt::print("{{\n");
+	fmt::print("  \"captures\": [");
+	for (size_t i = 0; i < paths.size(); i++)
+		fmt::print("{}\"{}\"", i ? ", " : "", escape(paths[i]));
+	fmt::print("],\n");
+	fmt::print("  \"results\": [\n");
+
+	// the advanced processor records 14 measurements and one counter sample per heatmap
+	std::size_t const trace_events = 16 * (basic + advanced);
+
+	std::unique_ptr<eval::perf::TraceSink> trace;
+	if (!trace_path.empty()) {
+		std::size_t const frames = heatmaps.size() * static_cast<std::size_t>(runs);
+		trace = std::make_unique<eval::perf::TraceSink>(frames * trace_events);
+	}
+
+	if (basic) {
+		Config cfg {};
+		cfg.size = size;
+		cfg.basic_pressure = pressure;
+
+		basic::TouchProcessor proc {cfg};
+		if (trace)
+			proc.perf().trace(trace.get(), "basic");
+
+		run(proc, heatmaps, runs, trace.get());
+		print("basic", size, runs, heatmaps.size(), proc.perf(), nullptr, !advanced);
+	}
+
+	if (advanced) {
+		advanced::TouchProcessor proc {size, approx};
+		if (trace)
+			proc.perf().trace(trace.get(), "advanced");
+
+		run(proc, heatmaps, runs, trace.get());
+		print("advanced", size, runs, heatmaps.size(), proc.perf(), &proc.scratch(), true);
+	}
+
+	fmt::print("  ]\n");
+	fmt::print("}}\n");
+
+	if (trace) {
+		trace->write(trace_path);
+
+		spdlog::info("Wrote {} trace events to {}", trace->size(), trace_path);
+		if (trace->dropped())
+			spdlog::warn("Dropped {} trace events", trace->dropped());
+	}
+
+	return 0;
+}
+
+} // namespace iptsd::debug::perf
+
+int main(int argc, char *argv[])
+{
+	// Keep stdout clean for the JSON output
+	spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+	spdlog::set_pattern("[%X.%e] [%^%l%$] %v");
+
+	try {
+		return iptsd::debug::perf::main(argc, argv);
+	} catch (std::exception &e) {
+		spdlog::error(e.what());
+		return EXIT_FAILURE;
+	}
+}
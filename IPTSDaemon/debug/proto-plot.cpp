@@ -1,6 +1,5 @@
 #include <common/types.hpp>
 #include <contacts/advanced/processor.hpp>
-#include <contacts/eval/perf.hpp>
 #include <container/image.hpp>
 #include <gfx/visualization.hpp>
 #include <ipts/parser.hpp>
@@ -23,14 +22,8 @@ using namespace iptsd::gfx;
 
 namespace iptsd::debug::plot {
 
-enum class mode_type {
-	plot,
-	perf,
-};
-
 static int main(int argc, char *argv[])
 {
-	auto mode = mode_type::perf;
 	auto path_in = std::string {"/Users/xavier/Desktop/dump_2_hex"};
 	auto path_out = std::string {"/Users/xavier/Desktop/dump_2_pic"};
 
@@ -79,35 +72,13 @@ static int main(int argc, char *argv[])
 
 	spdlog::info("Processing...");
 
-	int i = 0;
-	do {
-		for (auto const &hm : heatmaps) {
-			std::copy(hm.begin(), hm.end(), proc.hm().begin());
-			auto const &tp = proc.process();
-
-			out.push_back(hm);
-			out_tp.push_back(tp);
-		}
-	} while (++i < 50 && mode == mode_type::perf);
-
-	// statistics
-	spdlog::info("Performance Statistics:");
-
-	for (auto const &e : proc.perf().entries()) {
-		using ms = std::chrono::microseconds;
-
-		spdlog::info("  {}", e.name);
-		spdlog::info("    N:      {:8d}", e.n_measurements);
-		spdlog::info("    full:   {:8d}", e.total<ms>().count());
-		spdlog::info("    mean:   {:8d}", e.mean<ms>().count());
-		spdlog::info("    stddev: {:8d}", e.stddev<ms>().count());
-		spdlog::info("    min:    {:8d}", e.min<ms>().count());
-		spdlog::info("    max:    {:8d}", e.max<ms>().count());
-		spdlog::info("");
-	}
+	for (auto const &hm : heatmaps) {
+		std::copy(hm.begin(), hm.end(), proc.hm().begin());
+		auto const &tp = proc.process();
 
-	if (mode == mode_type::perf)
-		return 0;
+		out.push_back(hm);
+		out_tp.push_back(tp);
+	}
 
 	// plot
 	spdlog::info("Plotting...");
@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Replays a capture written by dump.cpp through the parser and the device handling of the
+ * daemon, and reports the throughput and the per-buffer latency. Does not need IOKit, so it
+ * can be built on any machine with:
+ *
+ *   cd IPTSDaemon && c++ -std=gnu++17 -O2 -I . -o iptsd-replay debug/replay.cpp \
+ *       daemon/replay.cpp daemon/parser.cpp daemon/pipeline.cpp daemon/trace.cpp \
+ *       daemon/devices.cpp daemon/config.cpp daemon/cone.cpp daemon/touch-manager.cpp \
+ *       daemon/stylus-manager.cpp contacts/processor.cpp contacts/advanced/processor.cpp \
+ *       contacts/basic/cluster.cpp contacts/basic/heatmap.cpp contacts/basic/processor.cpp \
+ *       -lfmt -lspdlog -linih -pthread
+ *
+ * The device configuration is loaded from the usual config directory.
+ *
+ * With --pipeline the buffers are processed by the threads of the daemon instead of
+ * synchronously, and the back-pressure counters of the queues are printed. The timings of the
+ * individual handlers are only recorded without it. Normally the buffers are only submitted
+ * once the threads have room for them, with --saturate they are submitted as fast as possible,
+ * like a driver that is faster than the processing. The tool fails if the stylus thread,
+ * which must never lose a buffer, skipped one.
+ *
+ * With --trace the spans of the last buffers are written to the given file, and the latency
+ * of a buffer from its receipt to its last HID report is summarized.
+ *
+ * With --perf-trace the timings of the handlers and of the touch processor are written to the
+ * given file in the Chrome trace event format, numbered by buffer. Only without --pipeline,
+ * since the registries are not thread-safe.
+ *
+ * With --check-alloc every allocation of the program after the first --warmup buffers (16 by
+ * default) is counted. Once the processing has been set up for the size of the heatmaps, it
+ * should not touch the heap anymore, no matter what the buffers contain, so the tool fails if
+ * anything was allocated. To find an allocation, break on iptsd::debug::replay::allocated().
+ * Only without --pipeline, the warm-up could not be told apart from the steady state on the
+ * other threads.
+ */
+
+#include <common/types.hpp>
+#include <contacts/eval/perf.hpp>
+#include <daemon/devices.hpp>
+#include <daemon/parser.hpp>
+#include <daemon/pipeline.hpp>
+#include <daemon/replay.hpp>
+#include <daemon/trace.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <fmt/format.h>
+#include <memory>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace iptsd::contacts::eval;
+
+namespace iptsd::debug::replay {
+
+static std::atomic_bool count_allocations {false};
+static std::atomic<UInt64> allocations {0};
+static std::atomic<UInt64> allocated_bytes {0};
+
+/*
+ * Called for every allocation while counting, not inlined so that a debugger can break on it.
+ */
+[[gnu::noinline]] void allocated(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void *allocate(std::size_t size, std::size_t align)
+{
+	if (count_allocations.load(std::memory_order_relaxed))
+		allocated(size);
+
+	// aligned_alloc() wants the size to be a multiple of the alignment
+	size = std::max<std::size_t>(size, 1);
+	void *p = align > alignof(std::max_align_t)
+			  ? std::aligned_alloc(align, (size + align - 1) / align * align)
+			  : std::malloc(size);
+
+	if (!p)
+		throw std::bad_alloc {};
+
+	return p;
+}
+
+static void usage()
+{
+	fmt::print(stderr, "Usage: iptsd-replay <capture> --vendor <hex> --product <hex> "
+			   "[--max-contacts <n>] [--paced] [--pipeline [--saturate]] [--repeat <n>] "
+			   "[--trace <file>] [--perf-trace <file>] [--check-alloc [--warmup <n>]]\n");
+}
+
+/*
+ * The time from the first to the last span of each frame that is completely in the trace.
+ */
+static void print_latency(const std::vector<daemon::trace::Span> &spans)
+{
+	std::unordered_map<UInt64, std::pair<UInt64, UInt64>> frames {};
+
+	for (auto const &span : spans) {
+		auto &range = frames.try_emplace(span.frame, span.begin, span.end).first->second;
+
+		range.first = std::min(range.first, span.begin);
+		range.second = std::max(range.second, span.end);
+	}
+
+	// the oldest frame may have lost spans to newer ones already
+	if (!spans.empty())
+		frames.erase(spans.front().frame);
+
+	std::vector<Float64> latency {};
+	for (auto const &[frame, range] : frames)
+		latency.push_back(static_cast<Float64>(range.second - range.first) / 1000);
+
+	if (latency.empty())
+		return;
+
+	std::sort(latency.begin(), latency.end());
+
+	auto const at = [&](Float64 p) {
+		auto const n = static_cast<Float64>(latency.size() - 1);
+		return latency[static_cast<std::size_t>(p / 100 * n)];
+	};
+
+	fmt::print("frame latency\n");
+	fmt::print("    N:      {:8d}\n", latency.size());
+	fmt::print("    p50:    {:8.1f} us\n", at(50));
+	fmt::print("    p99:    {:8.1f} us\n", at(99));
+	fmt::print("    max:    {:8.1f} us\n", latency.back());
+}
+
+static int main(int argc, char *argv[])
+{
+	std::string path;
+	IPTSDeviceInfo info {0, 0, IPTS_TOUCH_SCREEN_FINGER_CNT};
+	auto mode = daemon::Replay::Mode::fast;
+	int repeat = 1;
+	bool pipeline = false;
+	bool saturate = false;
+	std::string trace;
+	std::string perf_trace;
+	bool check_alloc = false;
+	UInt64 warmup = 16;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg {argv[i]};
+		bool has_value = i + 1 < argc;
+
+		if (arg == "--vendor" && has_value)
+			info.vendor_id = std::stoi(argv[++i], nullptr, 16);
+		else if (arg == "--product" && has_value)
+			info.product_id = std::stoi(argv[++i], nullptr, 16);
+		else if (arg == "--max-contacts" && has_value)
+			info.max_contacts = std::stoi(argv[++i]);
+		else if (arg == "--repeat" && has_value)
+			repeat = std::stoi(argv[++i]);
+		else if (arg == "--trace" && has_value)
+			trace = argv[++i];
+		else if (arg == "--perf-trace" && has_value)
+			perf_trace = argv[++i];
+		else if (arg == "--check-alloc")
+			check_alloc = true;
+		else if (arg == "--warmup" && has_value)
+			warmup = std::stoull(argv[++i]);
+		else if (arg == "--pipeline")
+			pipeline = true;
+		else if (arg == "--saturate")
+			saturate = true;
+		else if (arg == "--paced")
+			mode = daemon::Replay::Mode::paced;
+		else if (path.empty() && arg[0] != '-')
+			path = arg;
+		else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (path.empty() || (pipeline && (!perf_trace.empty() || check_alloc)) ||
+	    (saturate && !pipeline)) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	daemon::Replay ctrl(path, info, mode);
+	daemon::Parser parser;
+	daemon::DeviceManager devices(ctrl.info);
+
+	auto const vendor = ctrl.info.vendor_id;
+	auto const product = ctrl.info.product_id;
+	spdlog::info("Replaying {} buffers for device {:04X}:{:04X}", ctrl.frames(), vendor, product);
+
+	daemon::trace::enabled = !trace.empty();
+	daemon::trace::thread("input");
+
+	perf::Registry perf;
+	auto const perf_t_buffer = perf.create_entry("buffer");
+	auto const perf_t_singletouch = perf.create_entry("singletouch");
+	auto const perf_t_heatmap = perf.create_entry("heatmap");
+	auto const perf_t_stylus = perf.create_entry("stylus");
+	auto const perf_t_dft_stylus = perf.create_entry("dft-stylus");
+
+	std::unique_ptr<perf::TraceSink> sink;
+	if (!perf_trace.empty()) {
+		// a buffer has at most a few reports, the heatmap adds the stages of the processor
+		std::size_t const events = 24;
+		std::size_t const frames = ctrl.frames() * static_cast<std::size_t>(repeat);
+
+		sink = std::make_unique<perf::TraceSink>(frames * events);
+
+		perf.trace(sink.get(), "replay");
+		devices.touch.manager.processor.trace = sink.get();
+	}
+
+	parser.on_singletouch = [&](const auto &data) {
+		auto _r = perf.record(perf_t_singletouch);
+        IPTSHIDReport report;
+        devices.touch.process_singletouch_input(data, report);
+        ctrl.send_hid_report(report);
+    };
+    parser.on_heatmap = [&](const auto &data) {
+        if (devices.active_stylus_cnt > 0 && devices.conf.stylus_disable_touch)
+            return;
+		auto _r = perf.record(perf_t_heatmap);
+        IPTSHIDReport report;
+        if (devices.touch.process_heatmap_input(data, report))
+            ctrl.send_hid_report(report);
+    };
+    parser.on_stylus = [&](const auto &data) {
+		auto _r = perf.record(perf_t_stylus);
+        daemon::StylusDevice &stylus = devices.get_stylus(data.serial);
+        IPTSHIDReport report;
+        int status = stylus.process_stylus_input(data, report);
+        ctrl.send_hid_report(report);
+        devices.active_stylus_cnt += status;
+    };
+    parser.on_dft_stylus = [&](const auto &data) {
+		auto _r = perf.record(perf_t_dft_stylus);
+        daemon::DFTStylusDevice &stylus = devices.dft_stylus;
+        IPTSHIDReport report;
+        int status = stylus.process_dft_stylus_input(data, report);
+        if (status < -1)
+            return;
+        ctrl.send_hid_report(report);
+        devices.active_stylus_cnt += status;
+    };
+
+	UInt64 buffers = 0;
+	UInt64 errors = 0;
+	auto const start = perf::clock::now();
+
+	std::unique_ptr<daemon::Pipeline> pipe;
+	if (pipeline) {
+		pipe = std::make_unique<daemon::Pipeline>(
+			devices, ctrl.buffers,
+			[&](IPTSHIDReport &report) { ctrl.send_hid_report(report); });
+	}
+
+	for (int i = 0; i < repeat; i++) {
+		ctrl.rewind();
+
+		while (pipe && !ctrl.eof()) {
+			// the driver drops buffers that come too fast, replaying as fast as possible
+			// should measure the throughput of the threads instead
+			while (mode == daemon::Replay::Mode::fast && !saturate && pipe->full())
+				std::this_thread::yield();
+
+			pipe->submit(ctrl.receive());
+			buffers++;
+		}
+
+		while (!pipe && !ctrl.eof()) {
+			if (buffers == warmup)
+				count_allocations = check_alloc;
+
+			gsl::span<UInt8> &data = ctrl.read_input();
+			auto _r = perf.record(perf_t_buffer);
+
+			daemon::trace::frame(buffers);
+			if (sink)
+				sink->frame(buffers);
+			daemon::trace::Scope scope {daemon::trace::Stage::parse};
+
+			try {
+				parser.prepare(&data);
+				parser.parse();
+			} catch (std::out_of_range &e) {
+				errors++;
+			}
+
+			buffers++;
+		}
+	}
+
+	count_allocations = false;
+
+	// everything that was submitted is processed and sent before the threads stop
+	if (pipe)
+		pipe->stop();
+
+	auto const elapsed = perf::clock::now() - start;
+	auto const seconds = std::chrono::duration<Float64>(elapsed).count();
+
+	fmt::print("Buffers:      {}\n", buffers);
+	fmt::print("Errors:       {}\n", errors);
+	fmt::print("HID reports:  {}\n", ctrl.reports);
+	fmt::print("Elapsed:      {:.3f} s\n", seconds);
+	fmt::print("Throughput:   {:.1f} buffers/s\n", static_cast<Float64>(buffers) / seconds);
+	fmt::print("\n");
+
+	if (pipe) {
+		auto const stats = pipe->stats();
+		auto const print = [](const char *name, const daemon::Pipeline::Queue &queue,
+				      const char *full) {
+			fmt::print("{:<16}{:8d} queued {:8d} {:<7} {:8d} stale  peak {}\n", name,
+				   queue.pushed, queue.full, full, queue.stale, queue.peak);
+		};
+
+		print("touch", stats.touch, "dropped");
+		print("stylus", stats.stylus, "stalls");
+		print("touch reports", stats.touch_reports, "stalls");
+		print("stylus reports", stats.stylus_reports, "stalls");
+		fmt::print("{:<16}{:8d} published {:5d} dropped {:5d} coalesced\n", "heatmaps",
+			   stats.heatmaps.published, stats.heatmaps.dropped,
+			   stats.heatmaps.coalesced);
+		fmt::print("\n");
+
+		if (stats.stylus.stale > 0 || stats.stylus.pushed != buffers) {
+			spdlog::error("Pipeline: the stylus thread skipped {} of {} buffers",
+				      buffers - stats.stylus.pushed + stats.stylus.stale, buffers);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (auto const &e : perf.entries()) {
+		using us = std::chrono::microseconds;
+
+		if (e.n_measurements == 0)
+			continue;
+
+		fmt::print("{}\n", e.name);
+		fmt::print("    N:      {:8d}\n", e.n_measurements);
+		fmt::print("    mean:   {:8d} us\n", e.mean<us>().count());
+		fmt::print("    stddev: {:8d} us\n", e.stddev<us>().count());
+		fmt::print("    min:    {:8d} us\n", e.min<us>().count());
+		fmt::print("    p50:    {:8d} us\n", e.percentile<us>(50).count());
+		fmt::print("    p99:    {:8d} us\n", e.percentile<us>(99).count());
+		fmt::print("    p99.9:  {:8d} us\n", e.percentile<us>(99.9).count());
+		fmt::print("    max:    {:8d} us\n", e.max<us>().count());
+	}
+
+	if (sink) {
+		sink->write(perf_trace);
+		fmt::print("\nWrote {} perf trace events to {}\n", sink->size(), perf_trace);
+
+		if (sink->dropped())
+			spdlog::warn("Dropped {} perf trace events", sink->dropped());
+	}
+
+	if (!trace.empty()) {
+		std::size_t n = daemon::trace::dump(trace);
+
+		fmt::print("\nWrote {} trace spans to {}\n", n, trace);
+		print_latency(daemon::trace::global().snapshot());
+	}
+
+	if (check_alloc) {
+		UInt64 n = allocations.load();
+		UInt64 bytes = allocated_bytes.load();
+
+		fmt::print("\nAllocations after {} warm-up buffers: {} ({} bytes)\n", warmup, n,
+			   bytes);
+
+		if (n > 0)
+			return EXIT_FAILURE;
+	}
+
+	return 0;
+}
+
+} // namespace iptsd::debug::replay
+
+void *operator new(std::size_t size)
+{
+	return iptsd::debug::replay::allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+	return iptsd::debug::replay::allocate(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+	std::free(p);
+}
+
+int main(int argc, char *argv[])
+{
+	spdlog::set_pattern("[%X.%e] [%^%l%$] %v");
+	try {
+		return iptsd::debug::replay::main(argc, argv);
+	} catch (std::exception &e) {
+		spdlog::error(e.what());
+		return EXIT_FAILURE;
+	}
+}
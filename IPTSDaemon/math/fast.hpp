@@ -0,0 +1,301 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef IPTSD_MATH_FAST_HPP
+#define IPTSD_MATH_FAST_HPP
+
+#include <common/types.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Approximations of transcendental functions for Float32 and Float64.
+ *
+ * The functions consist only of arithmetic, comparisons and bit operations without branches
+ * or table lookups, so that the compiler can inline and vectorize loops calling them. Special
+ * values (NaN, infinities, denormals) are not handled, see the individual functions for the
+ * valid input ranges. The given maximum errors were measured against the standard library
+ * (iptsd-perf --math).
+ */
+namespace iptsd::math::fast {
+
+namespace impl {
+
+template <class T> struct bits {};
+
+template <> struct bits<Float32> {
+	using uint = UInt32;
+	using sint = SInt32;
+
+	static inline constexpr int mantissa = 23;
+	static inline constexpr sint bias = 127;
+
+	// exp() flushes to zero below lo and saturates above hi
+	static inline constexpr Float32 lo = -87.3f;
+	static inline constexpr Float32 hi = 88.0f;
+};
+
+template <> struct bits<Float64> {
+	using uint = UInt64;
+	using sint = SInt64;
+
+	static inline constexpr int mantissa = 52;
+	static inline constexpr sint bias = 1023;
+
+	static inline constexpr Float64 lo = -708.0;
+	static inline constexpr Float64 hi = 709.0;
+};
+
+template <class T> inline constexpr T ln2_hi = static_cast<T>(0.693359375);
+template <class T> inline constexpr T ln2_lo = static_cast<T>(-2.12194440054690582e-4);
+template <class T> inline constexpr T log2e = static_cast<T>(1.44269504088896340736);
+template <class T> inline constexpr T sqrt2 = static_cast<T>(1.41421356237309504880);
+template <class T> inline constexpr T pi = static_cast<T>(3.14159265358979323846);
+
+template <class T, class U> [[gnu::always_inline]] inline auto cast(U v) -> T
+{
+	static_assert(sizeof(T) == sizeof(U));
+
+	T r;
+	std::memcpy(&r, &v, sizeof(T));
+	return r;
+}
+
+template <class T, std::size_t N, std::size_t... I>
+[[gnu::always_inline]] inline auto pairs(T x, std::array<T, N> const &c, std::index_sequence<I...>)
+	-> std::array<T, (N + 1) / 2>
+{
+	return {(2 * I + 1 < N ? c[2 * I] + c[std::min(2 * I + 1, N - 1)] * x : c[2 * I])...};
+}
+
+/*
+ * c[0] + c[1] x + c[2] x^2 + ..., with Estrin's scheme: neighboring terms are combined in
+ * pairs, which are then combined with x^2, x^4 and so on. Needs the same number of operations
+ * as Horner's scheme, but the dependency chain only grows logarithmically with the degree.
+ */
+template <class T, std::size_t N>
+[[gnu::always_inline]] inline auto poly(T x, std::array<T, N> const &c) -> T
+{
+	if constexpr (N == 1)
+		return c[0];
+	else
+		return poly(x * x, pairs(x, c, std::make_index_sequence<(N + 1) / 2> {}));
+}
+
+} /* namespace impl */
+
+/*
+ * e^x, by reducing x to n * ln(2) + r with |r| <= ln(2) / 2 and a Taylor polynomial for e^r.
+ * Returns zero below -87.3 (Float32) / -708 (Float64) and saturates above 88 / 709.
+ *
+ * Max. relative error: 2.6e-7 (Float32), 4.8e-16 (Float64).
+ */
+template <class T> inline auto exp(T x) -> T
+{
+	using B = impl::bits<T>;
+	using U = typename B::uint;
+	using S = typename B::sint;
+
+	static_assert(std::is_floating_point_v<T>);
+
+	auto const flush = x < B::lo;
+	x = std::min(std::max(x, B::lo), B::hi);
+
+	// round to nearest by adding and subtracting 1.5 * 2^mantissa
+	T const shift = static_cast<T>(U {3} << (B::mantissa - 1));
+	T const n = (x * impl::log2e<T> + shift) - shift;
+
+	T const r = (x - n * impl::ln2_hi<T>) - n * impl::ln2_lo<T>;
+
+	T p;
+	if constexpr (std::is_same_v<T, Float32>) {
+		static constexpr std::array c = {1.0f,	     1.0f,	    1.0f / 2.0f,  1.0f / 6.0f,
+					  1.0f / 24.0f, 1.0f / 120.0f, 1.0f / 720.0f};
+		p = impl::poly(r, c);
+	} else {
+		static constexpr std::array c = {
+			1.0,
+			1.0,
+			1.0 / 2.0,
+			1.0 / 6.0,
+			1.0 / 24.0,
+			1.0 / 120.0,
+			1.0 / 720.0,
+			1.0 / 5040.0,
+			1.0 / 40320.0,
+			1.0 / 362880.0,
+			1.0 / 3628800.0,
+			1.0 / 39916800.0,
+			1.0 / 479001600.0,
+		};
+		p = impl::poly(r, c);
+	}
+
+	auto const e = static_cast<U>(static_cast<S>(n) + B::bias) << B::mantissa;
+	auto const v = p * impl::cast<T>(e);
+
+	return flush ? T {0} : v;
+}
+
+/*
+ * Natural logarithm, by splitting x into 2^e * m with sqrt(1/2) <= m < sqrt(2) and the series
+ * ln(m) = 2 atanh(s) with s = (m - 1) / (m + 1). x must be a positive normal number.
+ *
+ * Max. error: 1.2e-7 (Float32), 2.3e-16 (Float64), absolute where |ln(x)| <= 1 and relative
+ * elsewhere.
+ */
+template <class T> inline auto log(T x) -> T
+{
+	using B = impl::bits<T>;
+	using U = typename B::uint;
+	using S = typename B::sint;
+
+	static_assert(std::is_floating_point_v<T>);
+
+	auto const u = impl::cast<U>(x);
+	auto e = static_cast<S>(u >> B::mantissa) - B::bias;
+
+	U const mask = (U {1} << B::mantissa) - 1;
+	auto m = impl::cast<T>((u & mask) | (static_cast<U>(B::bias) << B::mantissa));
+
+	auto const big = m > impl::sqrt2<T>;
+	m = big ? m * T {0.5} : m;
+	e = big ? e + 1 : e;
+
+	T const s = (m - T {1}) / (m + T {1});
+	T const z = s * s;
+
+	T p;
+	if constexpr (std::is_same_v<T, Float32>) {
+		static constexpr std::array c = {1.0f, 1.0f / 3.0f, 1.0f / 5.0f, 1.0f / 7.0f, 1.0f / 9.0f};
+		p = impl::poly(z, c);
+	} else {
+		static constexpr std::array c = {
+			1.0,	    1.0 / 3.0,	1.0 / 5.0,  1.0 / 7.0,	1.0 / 9.0,
+			1.0 / 11.0, 1.0 / 13.0, 1.0 / 15.0, 1.0 / 17.0, 1.0 / 19.0,
+		};
+		p = impl::poly(z, c);
+	}
+
+	auto const te = static_cast<T>(e);
+
+	return te * impl::ln2_hi<T> + (T {2} * s * p + te * impl::ln2_lo<T>);
+}
+
+/*
+ * x^y as e^(y ln(x)). x must be a positive normal number. The relative error is that of exp()
+ * plus |y ln(x)| times the absolute error of log().
+ */
+template <class T> inline auto pow(T x, T y) -> T
+{
+	return fast::exp(y * fast::log(x));
+}
+
+/*
+ * Square root. The instruction of the CPU is correctly rounded and vectorizes, so there is
+ * nothing to gain from an approximation.
+ */
+template <class T> inline auto sqrt(T x) -> T
+{
+	return std::sqrt(x);
+}
+
+/*
+ * The angle of (x, y) in radians, by reducing the argument to [0, 1] and the polynomial
+ * approximation of atan() on that interval from Abramowitz and Stegun, 4.4.49. Returns zero
+ * for (0, 0).
+ *
+ * Max. absolute error: 4.8e-7 (Float32), 3.8e-8 (Float64).
+ */
+template <class T> inline auto atan2(T y, T x) -> T
+{
+	static_assert(std::is_floating_point_v<T>);
+
+	T const ax = std::abs(x);
+	T const ay = std::abs(y);
+
+	T const mx = std::max(ax, ay);
+	T const mn = std::min(ax, ay);
+	T const a = mx > T {0} ? mn / mx : T {0};
+
+	static constexpr std::array c = {
+		static_cast<T>(0.9999993329),  static_cast<T>(-0.3332985605),
+		static_cast<T>(0.1994653599),  static_cast<T>(-0.1390853351),
+		static_cast<T>(0.0964200441),  static_cast<T>(-0.0559098861),
+		static_cast<T>(0.0218612288),  static_cast<T>(-0.0040540580),
+	};
+
+	T r = a * impl::poly(a * a, c);
+
+	r = ay > ax ? impl::pi<T> / T {2} - r : r;
+	r = x < T {0} ? impl::pi<T> - r : r;
+
+	return y < T {0} ? -r : r;
+}
+
+/*
+ * Policies to select the implementation per call site, e.g. template <class M> ... M::exp(x).
+ * Std uses the standard library, Approx the approximations above.
+ */
+struct Std {
+	template <class T> static auto exp(T x) -> T
+	{
+		return std::exp(x);
+	}
+
+	template <class T> static auto log(T x) -> T
+	{
+		return std::log(x);
+	}
+
+	template <class T> static auto pow(T x, T y) -> T
+	{
+		return std::pow(x, y);
+	}
+
+	template <class T> static auto sqrt(T x) -> T
+	{
+		return std::sqrt(x);
+	}
+
+	template <class T> static auto atan2(T y, T x) -> T
+	{
+		return std::atan2(y, x);
+	}
+};
+
+struct Approx {
+	template <class T> static auto exp(T x) -> T
+	{
+		return fast::exp(x);
+	}
+
+	template <class T> static auto log(T x) -> T
+	{
+		return fast::log(x);
+	}
+
+	template <class T> static auto pow(T x, T y) -> T
+	{
+		return fast::pow(x, y);
+	}
+
+	template <class T> static auto sqrt(T x) -> T
+	{
+		return fast::sqrt(x);
+	}
+
+	template <class T> static auto atan2(T y, T x) -> T
+	{
+		return fast::atan2(y, x);
+	}
+};
+
+} /* namespace iptsd::math::fast */
+
+#endif /* IPTSD_MATH_FAST_HPP */
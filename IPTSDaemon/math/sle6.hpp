@@ -7,6 +7,9 @@
 #include "num.hpp"
 #include "vec6.hpp"
 
+#include <cmath>
+#include <limits>
+
 namespace iptsd::math {
 
 /**
@@ -221,6 +224,159 @@ template <class T> auto ge_solve(Mat6<T> a, Vec6<T> b, Vec6<T> &x, T eps = num<T
 	return true;
 }
 
+/*
+ * Relative tolerance for the pivots below which ldlt_solve() falls back to Gaussian elimination.
+ */
+template <class T>
+inline constexpr T ldlt_tol = static_cast<T>(64) * std::numeric_limits<T>::epsilon();
+
+/**
+ * ldlt_decomp() - Perform an LDL^T-decomposition of a symmetric matrix.
+ * @a:   The symmetric matrix to factorize. Only the lower triangle is read.
+ * @ld:  The result of the factorization, with L below and D on the diagonal.
+ * @tol: Relative tolerance for the pivots.
+ *
+ * Performs a decomposition A = LDL^T without pivoting, with L being a unit lower
+ * triangular matrix and D a diagonal matrix. Fails if a pivot is not larger than
+ * tol times the corresponding diagonal entry of A, i.e. if the matrix is not positive
+ * definite or too badly conditioned to be factorized without pivoting.
+ */
+template <class T>
+auto ldlt_decomp(Mat6<T> const &a, Mat6<T> &ld, T tol) -> bool
+{
+	auto const check = [&](index_t i) {
+		return ld[{i, i}] > tol * std::abs(a[{i, i}]);
+	};
+
+	T v0, v1, v2, v3, v4;
+
+	// column 0
+	ld[{0, 0}] = a[{0, 0}];
+	if (!check(0))
+		return false;
+
+	ld[{1, 0}] = a[{1, 0}] / ld[{0, 0}];
+	ld[{2, 0}] = a[{2, 0}] / ld[{0, 0}];
+	ld[{3, 0}] = a[{3, 0}] / ld[{0, 0}];
+	ld[{4, 0}] = a[{4, 0}] / ld[{0, 0}];
+	ld[{5, 0}] = a[{5, 0}] / ld[{0, 0}];
+
+	// column 1
+	v0 = ld[{1, 0}] * ld[{0, 0}];
+	ld[{1, 1}] = a[{1, 1}] - ld[{1, 0}] * v0;
+	if (!check(1))
+		return false;
+
+	ld[{2, 1}] = (a[{2, 1}] - ld[{2, 0}] * v0) / ld[{1, 1}];
+	ld[{3, 1}] = (a[{3, 1}] - ld[{3, 0}] * v0) / ld[{1, 1}];
+	ld[{4, 1}] = (a[{4, 1}] - ld[{4, 0}] * v0) / ld[{1, 1}];
+	ld[{5, 1}] = (a[{5, 1}] - ld[{5, 0}] * v0) / ld[{1, 1}];
+
+	// column 2
+	v0 = ld[{2, 0}] * ld[{0, 0}];
+	v1 = ld[{2, 1}] * ld[{1, 1}];
+	ld[{2, 2}] = a[{2, 2}] - ld[{2, 0}] * v0 - ld[{2, 1}] * v1;
+	if (!check(2))
+		return false;
+
+	ld[{3, 2}] = (a[{3, 2}] - ld[{3, 0}] * v0 - ld[{3, 1}] * v1) / ld[{2, 2}];
+	ld[{4, 2}] = (a[{4, 2}] - ld[{4, 0}] * v0 - ld[{4, 1}] * v1) / ld[{2, 2}];
+	ld[{5, 2}] = (a[{5, 2}] - ld[{5, 0}] * v0 - ld[{5, 1}] * v1) / ld[{2, 2}];
+
+	// column 3
+	v0 = ld[{3, 0}] * ld[{0, 0}];
+	v1 = ld[{3, 1}] * ld[{1, 1}];
+	v2 = ld[{3, 2}] * ld[{2, 2}];
+	ld[{3, 3}] = a[{3, 3}] - ld[{3, 0}] * v0 - ld[{3, 1}] * v1 - ld[{3, 2}] * v2;
+	if (!check(3))
+		return false;
+
+	ld[{4, 3}] = (a[{4, 3}] - ld[{4, 0}] * v0 - ld[{4, 1}] * v1 - ld[{4, 2}] * v2) / ld[{3, 3}];
+	ld[{5, 3}] = (a[{5, 3}] - ld[{5, 0}] * v0 - ld[{5, 1}] * v1 - ld[{5, 2}] * v2) / ld[{3, 3}];
+
+	// column 4
+	v0 = ld[{4, 0}] * ld[{0, 0}];
+	v1 = ld[{4, 1}] * ld[{1, 1}];
+	v2 = ld[{4, 2}] * ld[{2, 2}];
+	v3 = ld[{4, 3}] * ld[{3, 3}];
+	ld[{4, 4}] = a[{4, 4}] - ld[{4, 0}] * v0 - ld[{4, 1}] * v1 - ld[{4, 2}] * v2 -
+	             ld[{4, 3}] * v3;
+	if (!check(4))
+		return false;
+
+	ld[{5, 4}] = (a[{5, 4}] - ld[{5, 0}] * v0 - ld[{5, 1}] * v1 - ld[{5, 2}] * v2 -
+	              ld[{5, 3}] * v3) / ld[{4, 4}];
+
+	// column 5
+	v0 = ld[{5, 0}] * ld[{0, 0}];
+	v1 = ld[{5, 1}] * ld[{1, 1}];
+	v2 = ld[{5, 2}] * ld[{2, 2}];
+	v3 = ld[{5, 3}] * ld[{3, 3}];
+	v4 = ld[{5, 4}] * ld[{4, 4}];
+	ld[{5, 5}] = a[{5, 5}] - ld[{5, 0}] * v0 - ld[{5, 1}] * v1 - ld[{5, 2}] * v2 -
+	             ld[{5, 3}] * v3 - ld[{5, 4}] * v4;
+	if (!check(5))
+		return false;
+
+	return true;
+}
+
+/**
+ * ldlt_subst() - Solve a system of linear equations via a LDL^T-decomposition.
+ * @ld: The L and D matrices, encoded in one matrix.
+ * @b:  The right-hand-side vector of the system.
+ * @x:  The vector to solve for.
+ *
+ * Solves Ly = b by forward substitution, Dz = y by scaling and L^T x = z by backward
+ * substitution.
+ */
+template <class T> void ldlt_subst(Mat6<T> const &ld, Vec6<T> const &b, Vec6<T> &x)
+{
+	// step 1: solve Ly = b for y (forward substitution)
+	auto y = Vec6<T> {};
+
+	y[0] = b[0];
+	y[1] = b[1] - ld[{1, 0}] * y[0];
+	y[2] = b[2] - ld[{2, 0}] * y[0] - ld[{2, 1}] * y[1];
+	y[3] = b[3] - ld[{3, 0}] * y[0] - ld[{3, 1}] * y[1] - ld[{3, 2}] * y[2];
+	y[4] = b[4] - ld[{4, 0}] * y[0] - ld[{4, 1}] * y[1] - ld[{4, 2}] * y[2] - ld[{4, 3}] * y[3];
+	y[5] = b[5] - ld[{5, 0}] * y[0] - ld[{5, 1}] * y[1] - ld[{5, 2}] * y[2] -
+	       ld[{5, 3}] * y[3] - ld[{5, 4}] * y[4];
+
+	// step 2: solve Dz = y for z, and L^T x = z for x (backward substitution)
+	x[5] = y[5] / ld[{5, 5}];
+	x[4] = y[4] / ld[{4, 4}] - ld[{5, 4}] * x[5];
+	x[3] = y[3] / ld[{3, 3}] - ld[{5, 3}] * x[5] - ld[{4, 3}] * x[4];
+	x[2] = y[2] / ld[{2, 2}] - ld[{5, 2}] * x[5] - ld[{4, 2}] * x[4] - ld[{3, 2}] * x[3];
+	x[1] = y[1] / ld[{1, 1}] - ld[{5, 1}] * x[5] - ld[{4, 1}] * x[4] - ld[{3, 1}] * x[3] -
+	       ld[{2, 1}] * x[2];
+	x[0] = y[0] / ld[{0, 0}] - ld[{5, 0}] * x[5] - ld[{4, 0}] * x[4] - ld[{3, 0}] * x[3] -
+	       ld[{2, 0}] * x[2] - ld[{1, 0}] * x[1];
+}
+
+/**
+ * ldlt_solve() - Solve a symmetric system of linear equations.
+ * @a:   The symmetric system matrix A.
+ * @b:   The right-hand-side vector b.
+ * @x:   The vector to solve for.
+ * @eps: Threshold for the pivots of the fallback.
+ *
+ * Solves the system of linear equations Ax = b via a LDL^T-decomposition. If the
+ * matrix cannot be factorized reliably without pivoting, falls back to Gaussian
+ * elimination with partial pivoting.
+ */
+template <class T>
+auto ldlt_solve(Mat6<T> const &a, Vec6<T> const &b, Vec6<T> &x, T eps = num<T>::eps) -> bool
+{
+	auto ld = Mat6<T> {};
+	if (ldlt_decomp(a, ld, ldlt_tol<T>)) {
+		ldlt_subst(ld, b, x);
+		return true;
+	}
+
+	return ge_solve(a, b, x, eps);
+}
+
 } /* namespace iptsd::math */
 
 #endif /* IPTSD_MATH_SLE6_HPP */
@@ -9,7 +9,23 @@
 #ifndef IPTSKenerlUserShared_h
 #define IPTSKenerlUserShared_h
 
+#ifdef __APPLE__
 #include <IOKit/IOTypes.h>
+#else
+// Allow the userspace tools to be built without the IOKit headers
+#include <stdint.h>
+
+typedef uint8_t  UInt8;
+typedef int8_t   SInt8;
+typedef uint16_t UInt16;
+typedef int16_t  SInt16;
+typedef uint32_t UInt32;
+typedef int32_t  SInt32;
+typedef uint64_t UInt64;
+typedef int64_t  SInt64;
+typedef float    Float32;
+typedef double   Float64;
+#endif
 
 #ifndef PACKED
 #define PACKED __attribute__((packed))